@@ -66,6 +66,7 @@ namespace GUI
             m_iterations->numeric->Value = Decimal(callbacks->getIterations());
             m_timestep->numeric->Value = Decimal(callbacks->getTimestep());
             m_vertRows->numeric->Value = Decimal(callbacks->getVertexRows());
+            m_solver->numeric->Value = Decimal(callbacks->getSolver());
         }
 
         /**
@@ -398,6 +399,15 @@ namespace GUI
             m_callbacks->setSpacing(Decimal::ToDouble(spinbox->Value));
         }
 
+        /**
+        * On Cloth Solver Value Changed
+        */
+        System::Void SolverChanged(System::Object^ sender, System::EventArgs^ e)
+        {
+            NumericUpDown^ spinbox = static_cast<NumericUpDown^>(sender);
+            m_callbacks->setSolver(Decimal::ToDouble(spinbox->Value));
+        }
+
         /**
         * Chooses the selected radio button
         * @param button The button to choose as selected 
@@ -489,6 +499,10 @@ namespace GUI
             CreateSpinBox(m_spacing, path+"spacing.png", 
                 "Change the spacing between vertices", index++, 0.05, 0.1, 1.5,
                 gcnew System::EventHandler(this, &GUIForm::SpacingChanged));
+
+            CreateSpinBox(m_solver, path+"solver.png", 
+                "Change the cloth solver (0: Spring, 1: XPBD, 2: Implicit, 3: Projective, 4: VBD, 5: Multigrid, 6: Stencil)", index++, 1.0, 0.0, 6.0,
+                gcnew System::EventHandler(this, &GUIForm::SolverChanged));
         }
 
         /**
@@ -541,7 +555,7 @@ namespace GUI
         {
             const int controlSize = 32;
             const int panelX = 680;
-            const int panelY = 456 + (index*controlSize);
+            const int panelY = 424 + (index*controlSize);
             const int panelHeight = controlSize-4;
             const int numericX = panelX + controlSize + 3;
             const int numericY = panelY + 5;
@@ -652,6 +666,7 @@ namespace GUI
         SpinBox^ m_iterations;     ///< Spinbox for changing iterations
         SpinBox^ m_timestep;       ///< Spinbox for changing the timestep
         SpinBox^ m_spacing;        ///< Spinbox for changing the spacing between vertices
+        SpinBox^ m_solver;         ///< Spinbox for changing the cloth solver
 
         /**
         * Designer specific components
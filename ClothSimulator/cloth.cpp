@@ -5,13 +5,27 @@
 #include "cloth.h"
 #include "input.h"
 #include "particle.h"
+#include "particlestore.h"
 #include "collisionmesh.h"
-#include "spring.h"
+#include "springstore.h"
 #include "shader.h"
 #include "utils.h"
+#include "timer.h"
+#include "threadpool.h"
+#include "springsolver.h"
+#include "xpbdsolver.h"
+#include "implicitsolver.h"
+#include "projectivesolver.h"
+#include "vbdsolver.h"
+#include "multigridsolver.h"
+#include "stencilsolver.h"
+#include "tetherstore.h"
 
 #include <functional>
+#include <chrono>
 #include <algorithm>
+#include <array>
+#include <map>
 
 namespace 
 {
@@ -26,23 +40,81 @@ namespace
         MAX_COLORS
     };
 
+    /**
+    * Convergence acceleration for spring iterations
+    */
+    enum Acceleration
+    {
+        NO_ACCELERATION,
+        SOR,
+        CHEBYSHEV,
+        SOR_CHEBYSHEV,
+        MAX_ACCELERATIONS
+    };
+
+    const std::string ACCELERATION_NAMES[] = { "None", "SOR", "Chebyshev", "SOR+Chebyshev" };
+
     const int ROWS = 20;                   ///< Initial rows for the cloth 
-    const int ITERATIONS = 2;              ///< Initial iterations for the cloth
+    const int ITERATIONS = 1;              ///< Initial iterations for the cloth
     const float TIMESTEP = 0.45f;          ///< Initial timestep for the cloth
     const float DAMPING = 0.9f;            ///< Initial damping for the cloth
     const float SPACING = 0.75f;           ///< Initial particle spacing for the cloth
     const int PARTICLE_SUBDIVISIONS = 8;   ///< Subdivisions for cloth particles
     const float SMOOTH_INCREASE = 0.01f;   ///< Increase amount when changing smoothing
+    const float RELAXATION = 1.5f;         ///< Initial over-relaxation of spring corrections
+    const float SPECTRAL_RADIUS = 0.95f;   ///< Initial spectral radius for chebyshev weighting
+    const float TOLERANCE = 0.01f;         ///< Initial residual to stop adaptive iterations at
+    const int MINIMUM_ITERATIONS = 1;      ///< Initial fewest adaptive iterations
 
     const D3DXVECTOR3 STARTING_POSITION(0.5f, 8.0f, 0.0f); ///< Initial position for the cloth
+    const float INSTANCE_HEIGHT = 3.0f;    ///< Height each additional cloth starts above the last
+    const std::string MESH_PATH(".\\Resources\\Models\\banner.obj"); ///< Mesh to simulate instead of the grid
+    const float WELD_DISTANCE = 1.0e-4f;   ///< Distance mesh vertices are welded within
+
+    /**
+    * @param row/column The row and column of the required particle
+    * @param rows The number of rows for the cloth
+    * @return the index of the particle in grid at row/col
+    */
+    int GetGridIndex(int row, int column, int rows)
+    {
+        return (column * rows) + row;
+    }
+
+    /**
+    * @param index The index of the particle
+    * @param rows The number of rows for the cloth
+    * @param spacing The spacing between vertices
+    * @param origin The initial position for the center of the cloth
+    * @return the initial position of the particle
+    */
+    D3DXVECTOR3 GetGridPosition(int index, int rows, float spacing, const D3DXVECTOR3& origin)
+    {
+        const int mininum = -rows/2;
+        D3DXVECTOR3 position = origin;
+        position.x += (mininum + (index / rows))*spacing;
+        position.z += (mininum + (index % rows))*spacing;
+        return position;
+    }
+
+    /**
+    * @param index The index of the particle
+    * @param rows The number of rows for the cloth
+    * @return the uvs for the particle
+    */
+    D3DXVECTOR2 GetGridUVs(int index, int rows)
+    {
+        return D3DXVECTOR2((index % rows) * 0.5f, (index / rows) * 0.5f);
+    }
 }
 
-Cloth::Cloth(EnginePtr engine)
+Cloth::Cloth(EnginePtr engine, int instance)
     : m_selectedRow(1)
     , m_timestep(TIMESTEP)
     , m_timestepSquared(TIMESTEP * TIMESTEP)
     , m_damping(DAMPING)
     , m_springCount(0)
+    , m_requestedRows(0)
     , m_springIterations(ITERATIONS)
     , m_particleLength(0)
     , m_particleCount(0)
@@ -61,6 +133,25 @@ Cloth::Cloth(EnginePtr engine)
     , m_texture(nullptr)
     , m_shader(nullptr)
     , m_diagnosticParticle(0)
+    , m_solver(SPRING)
+    , m_useTethers(true)
+    , m_acceleration(NO_ACCELERATION)
+    , m_relaxation(RELAXATION)
+    , m_spectralRadius(SPECTRAL_RADIUS)
+    , m_adaptiveIterations(false)
+    , m_tolerance(TOLERANCE)
+    , m_minimumIterations(MINIMUM_ITERATIONS)
+    , m_useMaximumResidual(false)
+    , m_interpolation(1.0f)
+    , m_allowSleeping(true)
+    , m_renderedAsleep(false)
+    , m_primary(instance == 0)
+    , m_startPosition(STARTING_POSITION + D3DXVECTOR3(0.0f, instance * INSTANCE_HEIGHT, 0.0f))
+    , m_particles(new ParticleStore(engine))
+    , m_springs(new SpringStore())
+    , m_tethers(new TetherStore())
+    , m_solverTimer(new Stopwatch())
+    , m_threads(new ThreadPool(1))
 {
     D3DXVECTOR3 minimumScale(1.0f, 1.0f, 1.0f);
     D3DXVECTOR3 maximumScale(1.0f, 1.0f, 1.0f);
@@ -82,6 +173,16 @@ Cloth::Cloth(EnginePtr engine)
     m_colors[PINNED] = engine->diagnostic()->GetColor(Diagnostic::RED);
     m_colors[SELECTED] = engine->diagnostic()->GetColor(Diagnostic::CYAN);
 
+    m_solvers.resize(MAX_SOLVERS);
+    m_solvers[SPRING].reset(new SpringSolver());
+    m_solvers[XPBD].reset(new XpbdSolver());
+    m_solvers[IMPLICIT].reset(new ImplicitSolver());
+    m_solvers[PROJECTIVE].reset(new ProjectiveSolver());
+    m_solvers[VBD].reset(new VbdSolver());
+    m_solvers[MULTIGRID].reset(new MultigridSolver());
+    m_solvers[STENCIL].reset(new StencilSolver());
+
+    m_threadTimings.resize(ThreadPool::GetMaxThreads());
     CreateCloth(ROWS, SPACING);
 }
 
@@ -94,116 +195,458 @@ void Cloth::CreateCloth(int rows, float spacing)
     m_spacing = spacing;
     m_particleLength = rows;
     m_particleCount = rows*rows;
+    m_requestedRows = rows;
+
+    // Create the particles, removing any from octree no longer needed
+    m_particles->Resize(m_particleCount);
+    m_particles->SetGridLength(m_particleLength);
+    UpdateScale();
+
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        m_particles->Initialise(index, GetGridPosition(index, m_particleLength, m_spacing, m_startPosition),
+            GetGridUVs(index, m_particleLength), *m_template);
+    }
+    m_previousPositions = m_particles->GetPositions();
+
+    ApplyLayout(*BuildLayout(m_particleLength, m_spacing, m_subdivideCloth, m_startPosition));
+}
+
+void Cloth::CreateCloth(const Assimpmesh::SubMesh& mesh)
+{
+    std::string errorBuffer;
+    std::unique_ptr<Layout> layout = BuildMeshLayout(mesh, m_spacing, m_startPosition, errorBuffer);
+    if(!layout)
+    {
+        ShowMessageBox(errorBuffer);
+        return;
+    }
+
+    if(m_handleMode)
+    {
+        ChangeRow(m_selectedRow, false);
+    }
+
+    m_particleLength = 0;
+    m_particleCount = static_cast<int>(layout->positions.size());
+
+    m_particles->Resize(m_particleCount);
+    m_particles->SetGridLength(0);
+    UpdateScale();
+
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        m_particles->Initialise(index, layout->positions[index],
+            layout->uvs[index], *m_template);
+    }
+    m_previousPositions = m_particles->GetPositions();
+
+    ApplyLayout(*layout);
+}
+
+void Cloth::RescaleCloth(float spacing)
+{
+    const float scale = spacing / m_spacing;
+    m_spacing = spacing;
+    UpdateScale();
+
+    // Spacing doesn't change the grid so only distances need scaling
+    m_particles->Rescale(m_startPosition, scale, *m_template);
+    m_previousPositions = m_particles->GetPositions();
+    m_springs->ScaleRestLengths(scale);
+
+    for(auto& solver : m_solvers)
+    {
+        solver->Initialise(*m_particles, *m_springs);
+    }
+    m_tethers->Initialise(*m_particles, *m_springs);
 
-    // Remove any particles from octree no longer needed
-    int current = static_cast<int>(m_particles.size());
-    int difference = current - m_particleCount;
-    if(difference > 0)
+    UpdateVertexBuffer();
+}
+
+void Cloth::ResizeCloth(Layout& layout)
+{
+    if(m_handleMode)
+    {
+        ChangeRow(m_selectedRow, false);
+    }
+
+    // Particles still in the grid keep their state, only new rows and columns are created
+    std::vector<int> added;
+    m_particles->ResizeGrid(layout.rows, *m_template, added);
+    m_particleLength = layout.rows;
+    m_particleCount = layout.rows*layout.rows;
+
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        m_particles->SetUVs(index, GetGridUVs(index, m_particleLength));
+    }
+    for(int index : added)
+    {
+        m_particles->Initialise(index, GetGridPosition(index, m_particleLength, m_spacing, m_startPosition),
+            GetGridUVs(index, m_particleLength), *m_template);
+    }
+    m_previousPositions = m_particles->GetPositions();
+
+    ApplyLayout(layout);
+
+    if(m_handleMode)
     {
-        for(int i = current-difference; i < current; ++i)
+        ChangeRow(m_selectedRow, true);
+    }
+}
+
+std::unique_ptr<Cloth::Layout> Cloth::BuildMeshLayout(const Assimpmesh::SubMesh& mesh, 
+                                                      float spacing,
+                                                      const D3DXVECTOR3& origin,
+                                                      std::string& errorBuffer)
+{
+    // Weld vertices that only differ by their normals or uvs
+    std::map<std::array<long long, 3>, std::uint32_t> welded;
+    std::vector<std::uint32_t> weldedIndex(mesh.vertices.size());
+    std::vector<D3DXVECTOR3> positions;
+    std::vector<D3DXVECTOR2> uvs;
+
+    for(unsigned int i = 0; i < mesh.vertices.size(); ++i)
+    {
+        const Assimpmesh::Vertex& vertex = mesh.vertices[i];
+        const std::array<long long, 3> key = 
+        {
+            static_cast<long long>(floor(vertex.x / WELD_DISTANCE + 0.5f)),
+            static_cast<long long>(floor(vertex.y / WELD_DISTANCE + 0.5f)),
+            static_cast<long long>(floor(vertex.z / WELD_DISTANCE + 0.5f))
+        };
+
+        auto itr = welded.find(key);
+        if(itr == welded.end())
         {
-            m_engine->octree()->RemoveObject(m_particles[i]->GetCollisionMesh());
+            itr = welded.insert(std::make_pair(key, 
+                static_cast<std::uint32_t>(positions.size()))).first;
+            positions.push_back(D3DXVECTOR3(vertex.x, vertex.y, vertex.z));
+            uvs.push_back(D3DXVECTOR2(vertex.u, vertex.v));
         }
+        weldedIndex[i] = itr->second;
     }
 
-    // Create the particles
-    m_particles.resize(m_particleCount);
-    m_template->SetLocalScale(m_spacing/2.0f);
-    const int mininum = -m_particleLength/2;
-    const int maximum = m_particleLength/2;
+    // Remove any triangles collapsed by welding
+    std::vector<std::uint32_t> triangles;
+    triangles.reserve(mesh.indices.size());
+    for(unsigned int i = 0; i + 2 < mesh.indices.size(); i += POINTS_IN_FACE)
+    {
+        const std::uint32_t p1 = weldedIndex[mesh.indices[i]];
+        const std::uint32_t p2 = weldedIndex[mesh.indices[i+1]];
+        const std::uint32_t p3 = weldedIndex[mesh.indices[i+2]];
+        if(p1 != p2 && p2 != p3 && p1 != p3)
+        {
+            triangles.push_back(p1);
+            triangles.push_back(p2);
+            triangles.push_back(p3);
+        }
+    }
 
-    // Modify visual radius depending on the spacing
-    // Line chosen passes through (0.75, 0.15), (1.0, 0.18)
-    const float lineslope = 0.12f;
-    const float lineoffset = 0.06f;
-    const float visualRadius = (lineslope * m_spacing) + lineoffset;
+    if(triangles.empty())
+    {
+        errorBuffer = "Cloth mesh has no triangles to simulate";
+        return nullptr;
+    }
 
-    float UVu = 0;
-    float UVv = 0;
-    int index = 0;
+    /* Each triangle adds its three edges along with the vertex opposite each edge.
+    Sorting the edges by their vertices places the two triangles sharing an edge
+    next to each other. Order is [first vertex, second vertex, opposite vertex] */
 
-    for(int x = mininum; x < maximum; ++x)
+    const int count = static_cast<int>(positions.size());
+    const auto createEdges = [&triangles](std::vector<std::array<std::uint32_t, 3>>& edges)
     {
-        for(int z = mininum; z < maximum; ++z, ++index)
+        edges.clear();
+        for(unsigned int i = 0; i < triangles.size(); i += POINTS_IN_FACE)
         {
-            bool firstInitialisation = !m_particles[index].get();
-            D3DXVECTOR2 uvs(UVu, UVv);
-            D3DXVECTOR3 position = STARTING_POSITION;
-            position.x += x*m_spacing;
-            position.z += z*m_spacing;
-
-            if(firstInitialisation)
+            for(int j = 0; j < POINTS_IN_FACE; ++j)
             {
-                m_particles[index].reset(new Particle(m_engine));
+                const std::uint32_t p1 = triangles[i + j];
+                const std::uint32_t p2 = triangles[i + ((j + 1) % POINTS_IN_FACE)];
+                const std::uint32_t opposite = triangles[i + ((j + 2) % POINTS_IN_FACE)];
+                std::array<std::uint32_t, 3> edge = { min(p1, p2), max(p1, p2), opposite };
+                edges.push_back(edge);
             }
+        }
+        std::sort(edges.begin(), edges.end());
+    };
+
+    std::vector<std::array<std::uint32_t, 3>> edges;
+    createEdges(edges);
+
+    // Order the particles breadth first across the edges so neighbours are close in memory
+    std::vector<int> offsets(count + 1, 0);
+    for(const auto& edge : edges)
+    {
+        ++offsets[edge[0] + 1];
+        ++offsets[edge[1] + 1];
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    std::vector<std::uint32_t> adjacent(offsets[count]);
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    for(const auto& edge : edges)
+    {
+        adjacent[next[edge[0]]++] = edge[1];
+        adjacent[next[edge[1]]++] = edge[0];
+    }
 
-            m_particles[index]->Initialise(position, uvs, 
-                index, *m_template, visualRadius);
+    const std::uint32_t unvisited = static_cast<std::uint32_t>(-1);
+    std::vector<std::uint32_t> order;
+    std::vector<std::uint32_t> rank(count, unvisited);
+    order.reserve(count);
 
-            if(firstInitialisation)
+    for(int start = 0; start < count; ++start)
+    {
+        if(rank[start] != unvisited)
+        {
+            continue;
+        }
+
+        rank[start] = static_cast<std::uint32_t>(order.size());
+        order.push_back(start);
+        for(unsigned int i = order.size() - 1; i < order.size(); ++i)
+        {
+            for(int j = offsets[order[i]]; j < offsets[order[i] + 1]; ++j)
             {
-                m_engine->octree()->AddObject(m_particles[index]->GetCollisionMesh());
+                if(rank[adjacent[j]] == unvisited)
+                {
+                    rank[adjacent[j]] = static_cast<std::uint32_t>(order.size());
+                    order.push_back(adjacent[j]);
+                }
             }
+        }
+    }
+
+    // Scale the mesh so its average edge matches the spacing and center it on the start
+    D3DXVECTOR3 minBounds(positions[0]);
+    D3DXVECTOR3 maxBounds(positions[0]);
+    for(const D3DXVECTOR3& position : positions)
+    {
+        D3DXVec3Minimize(&minBounds, &minBounds, &position);
+        D3DXVec3Maximize(&maxBounds, &maxBounds, &position);
+    }
 
-            UVu += 0.5;
+    double edgeLength = 0.0;
+    int edgeCount = 0;
+    for(unsigned int i = 0; i < edges.size(); ++i)
+    {
+        if(i == 0 || edges[i][0] != edges[i-1][0] || edges[i][1] != edges[i-1][1])
+        {
+            const D3DXVECTOR3 difference(positions[edges[i][1]] - positions[edges[i][0]]);
+            edgeLength += D3DXVec3Length(&difference);
+            ++edgeCount;
         }
-        UVu = 0;
-        UVv += 0.5;
+    }
+    edgeLength /= edgeCount;
+    const float scale = edgeLength > 0.0 ? spacing / static_cast<float>(edgeLength) : 1.0f;
+    const D3DXVECTOR3 center((minBounds + maxBounds) * 0.5f);
+
+    std::unique_ptr<Layout> layout(new Layout());
+    layout->rows = 0;
+    layout->spacing = spacing;
+    layout->springs.reset(new SpringStore());
+    layout->positions.resize(count);
+    layout->uvs.resize(count);
+
+    for(int i = 0; i < count; ++i)
+    {
+        layout->positions[i] = origin + ((positions[order[i]] - center) * scale);
+        layout->uvs[i] = uvs[order[i]];
     }
 
-    // Set a centered particle as the one to draw any diagnostics
-    m_diagnosticParticle = ((m_particleLength/2) * m_particleLength) + (m_particleLength/2);
-    auto& collision = m_particles[m_diagnosticParticle]->GetCollisionMesh();
-    collision.SetRenderSolverDiagnostics(true);
+    for(std::uint32_t& index : triangles)
+    {
+        index = rank[index];
+    }
+    layout->indices.assign(triangles.begin(), triangles.end());
+    createEdges(edges);
 
-    // Create the vertices
-    m_quadVertices = m_subdivideCloth ? ((m_particleLength-1)*(m_particleLength-1)) : 0;
-    const int vertexCount = m_particleCount + m_quadVertices;
-    m_vertexData.resize(vertexCount);
+    /* Stretch springs join the two vertices of each edge and bend springs join the
+    two vertices opposite an edge shared by two triangles. Springs are colored
+    greedily so no two of the same type and color share a particle. Edges with
+    a single triangle are on the boundary and aren't smoothed */
+
+    std::vector<std::array<std::uint32_t, 3>> springs;
+    std::vector<unsigned char> boundary(count, 0);
+    for(unsigned int i = 0; i < edges.size(); ++i)
+    {
+        const bool shared = i + 1 < edges.size() && 
+            edges[i][0] == edges[i+1][0] && edges[i][1] == edges[i+1][1];
+
+        const bool duplicate = i > 0 && 
+            edges[i][0] == edges[i-1][0] && edges[i][1] == edges[i-1][1];
+
+        if(!duplicate)
+        {
+            std::array<std::uint32_t, 3> spring = { edges[i][0], edges[i][1], SpringStore::STRETCH };
+            springs.push_back(spring);
+        }
+
+        if(shared && !duplicate && edges[i][2] != edges[i+1][2])
+        {
+            std::array<std::uint32_t, 3> spring = { min(edges[i][2], edges[i+1][2]), 
+                max(edges[i][2], edges[i+1][2]), SpringStore::BEND };
+            springs.push_back(spring);
+        }
+
+        if(!shared && !duplicate)
+        {
+            boundary[edges[i][0]] = 1;
+            boundary[edges[i][1]] = 1;
+        }
+    }
+
+    std::vector<unsigned int> usedColors(count * SpringStore::MAX_TYPES, 0);
+    SpringStore& springStore = *layout->springs;
+    springStore.Reset(static_cast<int>(springs.size()));
+
+    for(const auto& spring : springs)
+    {
+        unsigned int& used1 = usedColors[(spring[0] * SpringStore::MAX_TYPES) + spring[2]];
+        unsigned int& used2 = usedColors[(spring[1] * SpringStore::MAX_TYPES) + spring[2]];
+
+        int color = 0;
+        while(color < SpringStore::COLORS_PER_TYPE && ((used1 | used2) & (1 << color)))
+        {
+            ++color;
+        }
+
+        if(color == SpringStore::COLORS_PER_TYPE)
+        {
+            errorBuffer = "Cloth mesh has vertices joined to too many edges";
+            return nullptr;
+        }
+
+        used1 |= 1 << color;
+        used2 |= 1 << color;
+        springStore.AddSpring(layout->positions, spring[0], spring[1],
+            static_cast<SpringStore::Type>(spring[2]), color);
+    }
+
+    layout->springCount = springStore.Size();
+    springStore.CreateBatches();
+    springStore.CreateParticleBatches(count, std::vector<unsigned char>());
+
+    // Interior particles are smoothed towards the particles sharing an edge
+    layout->neighbourOffsets.assign(count + 1, 0);
+    for(int i = 0; i < count; ++i)
+    {
+        const std::uint32_t particle = order[i];
+        layout->neighbourOffsets[i] = static_cast<int>(layout->neighbours.size());
+        if(!boundary[i])
+        {
+            for(int j = offsets[particle]; j < offsets[particle + 1]; ++j)
+            {
+                layout->neighbours.push_back(rank[adjacent[j]]);
+            }
+        }
+    }
+    layout->neighbourOffsets[count] = static_cast<int>(layout->neighbours.size());
+
+    return layout;
+}
+
+void Cloth::UpdateScale()
+{
+    m_particles->SetGridSpacing(m_spacing);
+    m_template->SetLocalScale(m_spacing/2.0f);
+
+    // Modify visual radius depending on the spacing
+    // Line chosen passes through (0.75, 0.15), (1.0, 0.18)
+    const float lineslope = 0.12f;
+    const float lineoffset = 0.06f;
+    m_particles->SetVisualRadius((lineslope * m_spacing) + lineoffset);
+}
+
+void Cloth::StartRebuild()
+{
+    m_pendingLayout = std::async(std::launch::async, &Cloth::BuildLayout, 
+        m_requestedRows, m_spacing, m_subdivideCloth, m_startPosition);
+}
+
+void Cloth::UpdateRebuild()
+{
+    if(m_pendingLayout.valid() && m_pendingLayout.wait_for(
+        std::chrono::seconds(0)) == std::future_status::ready)
+    {
+        std::unique_ptr<Layout> layout = m_pendingLayout.get();
+        ResizeCloth(*layout);
+
+        // Rows may have changed again while building
+        if(m_requestedRows != m_particleLength)
+        {
+            StartRebuild();
+        }
+    }
+}
+
+std::unique_ptr<Cloth::Layout> Cloth::BuildLayout(int rows, 
+                                                  float spacing, 
+                                                  bool subdivide, 
+                                                  const D3DXVECTOR3& origin)
+{
+    std::unique_ptr<Layout> layout(new Layout());
+    layout->rows = rows;
+    layout->spacing = spacing;
+    layout->springs.reset(new SpringStore());
+
+    const int count = rows*rows;
+    std::vector<D3DXVECTOR3> positions(count);
+    for(int index = 0; index < count; ++index)
+    {
+        positions[index] = GetGridPosition(index, rows, spacing, origin);
+    }
 
     // Create the indices
-    const int trianglesPerQuad = m_subdivideCloth ? 4 : 2;
-    int triangleNumber = ((m_particleLength-1)*(m_particleLength-1)) * trianglesPerQuad;
-    m_indexData.resize(triangleNumber * POINTS_IN_FACE);
+    layout->quadVertices = subdivide ? ((rows-1)*(rows-1)) : 0;
+    const int trianglesPerQuad = subdivide ? 4 : 2;
+    const int triangleNumber = ((rows-1)*(rows-1)) * trianglesPerQuad;
+    std::vector<DWORD>& indexData = layout->indices;
+    indexData.resize(triangleNumber * POINTS_IN_FACE);
 
-    index = 0;
+    int index = 0;
     int quad = 0;
 
-    for(int x = 0; x < m_particleLength-1; ++x)
+    for(int x = 0; x < rows-1; ++x)
     {
-        for(int y = 0; y < m_particleLength-1; ++y)
+        for(int y = 0; y < rows-1; ++y)
         {
-            if(m_subdivideCloth)
+            if(subdivide)
             {
-                m_indexData[index]   = (x*m_particleLength)+y;
-                m_indexData[index+1] = (x*m_particleLength)+y+1;
-                m_indexData[index+2] = m_particleCount + quad;
+                indexData[index]   = (x*rows)+y;
+                indexData[index+1] = (x*rows)+y+1;
+                indexData[index+2] = count + quad;
 
-                m_indexData[index+3] = m_particleCount + quad;
-                m_indexData[index+4] = (x*m_particleLength)+y+1;
-                m_indexData[index+5] = ((x+1)*m_particleLength)+y+1;
+                indexData[index+3] = count + quad;
+                indexData[index+4] = (x*rows)+y+1;
+                indexData[index+5] = ((x+1)*rows)+y+1;
             
-                m_indexData[index+6] = ((x+1)*m_particleLength)+y;
-                m_indexData[index+7] = ((x+1)*m_particleLength)+y+1;
-                m_indexData[index+8] = m_particleCount + quad;
+                indexData[index+6] = ((x+1)*rows)+y;
+                indexData[index+7] = ((x+1)*rows)+y+1;
+                indexData[index+8] = count + quad;
             
-                m_indexData[index+9] = (x*m_particleLength)+y;
-                m_indexData[index+10] = m_particleCount + quad;
-                m_indexData[index+11] = ((x+1)*m_particleLength)+y;
+                indexData[index+9] = (x*rows)+y;
+                indexData[index+10] = count + quad;
+                indexData[index+11] = ((x+1)*rows)+y;
             }
             else
             {
-                m_indexData[index] = (x*m_particleLength)+y;
-                m_indexData[index+1] = (x*m_particleLength)+y+1;
-                m_indexData[index+2] = ((x+1)*m_particleLength)+y;
+                indexData[index] = (x*rows)+y;
+                indexData[index+1] = (x*rows)+y+1;
+                indexData[index+2] = ((x+1)*rows)+y;
 
-                m_indexData[index+3] = ((x+1)*m_particleLength)+y;
-                m_indexData[index+4] = (x*m_particleLength)+y+1;
-                m_indexData[index+5] = ((x+1)*m_particleLength)+y+1;
+                indexData[index+3] = ((x+1)*rows)+y;
+                indexData[index+4] = (x*rows)+y+1;
+                indexData[index+5] = ((x+1)*rows)+y+1;
             }
 
             ++quad;
-            index += m_subdivideCloth ? 12 : 6;
+            index += subdivide ? 12 : 6;
         }
     }
 
@@ -213,80 +656,116 @@ void Cloth::CreateCloth(int rows, float spacing)
     -------    Shear: Cross springs
     |  |  |    Bending: Link every second horizontal/vertical vertex
     ------              
-    y */
+    y
 
-    auto createSpring = [this](int i) -> int
-    {
-        if(!m_springs[i+1].get())
-        {
-            m_springs[i+1].reset(new Spring());
-        }
-        return i+1;
-    };
+    Springs are colored so no two of the same type and color share a
+    particle, alternating along the row/column for each spring direction */
 
-    m_springCount = ((m_particleLength-1)*(((m_particleLength-2)*2)+2)) 
-        + (m_particleLength*(m_particleLength-1)) 
-        + (m_particleLength*(m_particleLength-2))
-        + ((m_particleLength-2)*m_particleLength)
-        + ((m_particleLength-1)*m_particleLength);
+    SpringStore& springs = *layout->springs;
+    layout->springCount = ((rows-1)*(((rows-2)*2)+2)) 
+        + (rows*(rows-1)) 
+        + (rows*(rows-2))
+        + ((rows-2)*rows)
+        + ((rows-1)*rows);
 
-    m_springs.resize(m_springCount);
-    index = -1;
-    for(int x = 0; x < m_particleLength; ++x)
+    springs.Reset(layout->springCount);
+    for(int x = 0; x < rows; ++x)
     {
-        for(int y = 0; y < m_particleLength; ++y)
+        for(int y = 0; y < rows; ++y)
         {
             //Last y doesn't have cross springs
-            if(y < m_particleLength-1)
+            if(y < rows-1)
             {
-                if(x < m_particleLength-1) //Don't create right cross if last x
+                if(x < rows-1) //Don't create right cross if last x
                 {
-                    index = createSpring(index);
-                    m_springs[index]->Initialise(*GetParticle(x,y),
-                        *GetParticle(x+1,y+1), index, Spring::SHEAR);
+                    springs.AddSpring(positions, GetGridIndex(x,y,rows),
+                        GetGridIndex(x+1,y+1,rows), SpringStore::SHEAR, x%2);
                 }
 
                 if(x > 0) //Don't create left cross if first x
                 {
-                    index = createSpring(index);
-                    m_springs[index]->Initialise(*GetParticle(x,y),
-                        *GetParticle(x-1,y+1), index, Spring::SHEAR);
+                    springs.AddSpring(positions, GetGridIndex(x,y,rows),
+                        GetGridIndex(x-1,y+1,rows), SpringStore::SHEAR, 2+(x%2));
                 }
             }
 
             //Last 2 xs doesn't have bending horizontal springs
-            if(x < m_particleLength-2)
+            if(x < rows-2)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x+2,y), index, Spring::BEND);
+                springs.AddSpring(positions, GetGridIndex(x,y,rows),
+                    GetGridIndex(x+2,y,rows), SpringStore::BEND, (x/2)%2);
             }
 
             //Last x doesn't have horizontal springs
-            if(x < m_particleLength-1)
+            if(x < rows-1)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x+1,y), index, Spring::STRETCH);
+                springs.AddSpring(positions, GetGridIndex(x,y,rows),
+                    GetGridIndex(x+1,y,rows), SpringStore::STRETCH, x%2);
             }
 
             //Last 2ys doesn't have bending vertical springs
-            if(y < m_particleLength-2)
+            if(y < rows-2)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x,y+2), index, Spring::BEND);
+                springs.AddSpring(positions, GetGridIndex(x,y,rows),
+                    GetGridIndex(x,y+2,rows), SpringStore::BEND, 2+((y/2)%2));
             }
             
             //Last y doesn't have vertical springs
-            if(y < m_particleLength-1)
+            if(y < rows-1)
             {
-                index = createSpring(index);
-                m_springs[index]->Initialise(*GetParticle(x,y),
-                    *GetParticle(x,y+1), index, Spring::STRETCH);
+                springs.AddSpring(positions, GetGridIndex(x,y,rows),
+                    GetGridIndex(x,y+1,rows), SpringStore::STRETCH, 2+(y%2));
             }
         }
     }
+    springs.CreateBatches();
+
+    /* Color the particles so no two connected by a spring share a color.
+    Neighbours are offset by (1,0), (2,0), (1,1) and their mirrors, none of
+    which leave (x + 2y) unchanged modulo 5 */
+
+    std::vector<unsigned char> colors(count);
+    for(int x = 0; x < rows; ++x)
+    {
+        for(int y = 0; y < rows; ++y)
+        {
+            colors[GetGridIndex(x,y,rows)] = static_cast<unsigned char>((x + (2*y)) % 5);
+        }
+    }
+    springs.CreateParticleBatches(count, colors);
+
+    return layout;
+}
+
+void Cloth::ApplyLayout(Layout& layout)
+{
+    // Set a centered particle as the one to draw any diagnostics
+    m_diagnosticParticle = ((m_particleLength/2) * m_particleLength) + (m_particleLength/2);
+    auto& collision = m_particles->GetCollisionMesh(m_diagnosticParticle);
+    collision.SetRenderSolverDiagnostics(m_primary);
+
+    m_neighbourOffsets.swap(layout.neighbourOffsets);
+    m_neighbours.swap(layout.neighbours);
+
+    // Springs are built for the spacing when the layout was requested
+    if(layout.spacing != m_spacing)
+    {
+        layout.springs->ScaleRestLengths(m_spacing / layout.spacing);
+    }
+    m_springs.swap(layout.springs);
+    m_springCount = layout.springCount;
+    UpdateCollisionMask();
+
+    // Create the vertices
+    m_quadVertices = layout.quadVertices;
+    m_vertexData.resize(m_particleCount + m_quadVertices);
+    m_indexData.swap(layout.indices);
+
+    for(auto& solver : m_solvers)
+    {
+        solver->Initialise(*m_particles, *m_springs);
+    }
+    m_tethers->Initialise(*m_particles, *m_springs);
 
     //Mesh Vertex Declaration
     D3DVERTEXELEMENT9 VertexDec[] =
@@ -304,6 +783,7 @@ void Cloth::CreateCloth(int rows, float spacing)
         m_mesh = nullptr;
     }
 
+    const int triangleNumber = static_cast<int>(m_indexData.size()) / POINTS_IN_FACE;
     if(FAILED(D3DXCreateMesh(triangleNumber, m_vertexData.size(),
         D3DXMESH_VB_DYNAMIC | D3DXMESH_IB_MANAGED | D3DXMESH_32BIT,
         VertexDec, m_engine->device(), &m_mesh)))
@@ -335,6 +815,31 @@ void Cloth::CreateCloth(int rows, float spacing)
     m_mesh->UnlockIndexBuffer();
 }
 
+void Cloth::UpdateCollisionMask()
+{
+    // Count the springs attached to each particle
+    const auto& indices = m_springs->GetIndices();
+    m_collisionMaskOffsets.assign(m_particleCount + 1, 0);
+    for(std::uint32_t index : indices)
+    {
+        ++m_collisionMaskOffsets[index + 1];
+    }
+
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        m_collisionMaskOffsets[i + 1] += m_collisionMaskOffsets[i];
+    }
+
+    // Fill in the particle at the other end of each spring
+    std::vector<int> filled(m_collisionMaskOffsets.begin(), m_collisionMaskOffsets.end() - 1);
+    m_collisionMask.resize(indices.size());
+    for(unsigned int i = 0; i < indices.size(); i += 2)
+    {
+        m_collisionMask[filled[indices[i]]++] = indices[i+1];
+        m_collisionMask[filled[indices[i+1]]++] = indices[i];
+    }
+}
+
 void Cloth::Draw(const D3DXVECTOR3& cameraPos, const Matrix& projection, const Matrix& view)
 {
     m_shader->SetTechnique(DxConstant::DefaultTechnique);
@@ -380,99 +885,192 @@ void Cloth::SetCollisionVisibility(bool draw)
 
 void Cloth::UnpinCloth()
 {
-    auto unpinParticle = [this](const ParticlePtr& part)
-    { 
-        part->PinParticle(false); 
-        SetParticleColor(part);
-    };
-    std::for_each(m_particles.begin(), m_particles.end(), unpinParticle);
+    for(int i = 0; i < m_particleCount; ++i)
+    {
+        m_particles->SetFlag(i, ParticleStore::PINNED, false);
+        SetParticleColor(i);
+    }
+    m_tethers->RemoveAllPins();
 }
 
 void Cloth::AddForce(const D3DXVECTOR3& force)
 {
-    for(const ParticlePtr& particle : m_particles)
-    {
-        particle->AddForce(force);
-    }
+    m_particles->AddForce(force);
 }
 
 void Cloth::PreCollisionUpdate(float deltatime)
 {
-    UpdateDiagnostics();
+    // Swap in any rebuilt cloth between ticks
+    UpdateRebuild();
+
+    // Only the first cloth in the scene shares the diagnostics
+    if(m_primary)
+    {
+        UpdateDiagnostics();
+    }
+
+    // Keep the last state to interpolate from when rendering and sweep from
+    m_previousPositions = m_particles->GetPositions();
+    m_particles->SaveTickPositions();
 
     // Move cloth down slowly
     if(m_simulation)
     {
         AddForce(m_gravity*m_timestepSquared*deltatime);
     }
-    
-    // Solve Springs
-    for(int j = 0; j < m_springIterations; ++j)
+}
+
+void Cloth::Solve()
+{
+    // Solve springs and update particle positions
+    SolverSettings settings;
+    settings.timestep = m_timestep;
+    settings.timestepSquared = m_timestepSquared;
+    settings.damping = m_damping;
+    settings.iterations = m_springIterations;
+    settings.relaxation = (m_acceleration == SOR || m_acceleration == SOR_CHEBYSHEV) ? m_relaxation : 1.0f;
+    settings.spectralRadius = (m_acceleration == CHEBYSHEV || m_acceleration == SOR_CHEBYSHEV) ? m_spectralRadius : 0.0f;
+
+    settings.minimumIterations = m_minimumIterations;
+    settings.tolerance = m_adaptiveIterations ? m_tolerance : 0.0f;
+    settings.useMaximumResidual = m_useMaximumResidual;
+
+    m_stats.iterations = 0;
+    m_stats.residual = 0.0f;
+    m_stats.timeSaved = 0.0;
+    m_stats.residuals.clear();
+
+    // Measuring the residual has a cost so is only done when needed
+    const bool useStats = m_adaptiveIterations || (m_primary &&
+        m_engine->diagnostic()->AllowDiagnostics(Diagnostic::CLOTH));
+    settings.stats = useStats ? &m_stats : nullptr;
+
+    // A fully resting cloth has nothing to solve until it is disturbed
+    if(!m_particles->IsAsleep())
     {
-        for(const SpringPtr& spring : m_springs)
+        m_solverTimer->Start();
+        m_solvers[m_solver]->Solve(*m_particles, *m_springs, *m_threads, settings);
+        if(m_useTethers)
         {
-            spring->SolveSpring(m_timestep);
+            m_tethers->Solve(*m_particles, *m_threads);
         }
+        m_solverTimer->Stop();
+        m_threadTimings[m_threads->GetThreadCount()-1] = m_solverTimer->GetAverageTime();
     }
 
-    // Updating particle positions
-    for(const ParticlePtr& particle : m_particles)
+    // Estimate the time of the skipped iterations from those that were run
+    if(m_stats.iterations > 0 && m_stats.iterations < m_springIterations)
     {
-        particle->PreCollisionUpdate(m_damping, m_timestepSquared);
+        m_stats.timeSaved = m_solverTimer->GetLastTime() / m_stats.iterations 
+            * (m_springIterations - m_stats.iterations);
     }
+
+    m_particles->ClearForces();
+    m_particles->UpdateCollisionPositions();
 }
 
 void Cloth::UpdateDiagnostics()
 {
     auto& renderer = *m_engine->diagnostic();
-    m_particles[m_diagnosticParticle]->UpdateDiagnostics(renderer);
+    GetParticle(m_diagnosticParticle).UpdateDiagnostics(renderer);
 
     if(renderer.AllowDiagnostics(Diagnostic::CLOTH))
     {
-        std::for_each(m_springs.begin(), m_springs.end(), 
-            [this, &renderer](const SpringPtr& spring)
-            { 
-                spring->UpdateDiagnostic(renderer); 
-            });
+        m_springs->UpdateDiagnostic(renderer, *m_particles);
 
         renderer.UpdateText(Diagnostic::CLOTH, 
             "ParticleCount", Diagnostic::WHITE, StringCast(m_particleCount));
 
         renderer.UpdateText(Diagnostic::CLOTH, 
             "Smoothing", Diagnostic::WHITE, StringCast(m_generalSmoothing));
+
+        renderer.UpdateText(Diagnostic::CLOTH, "Solver", 
+            Diagnostic::WHITE, m_solvers[m_solver]->GetName());
+
+        renderer.UpdateText(Diagnostic::CLOTH, "Tethers", Diagnostic::WHITE,
+            m_useTethers ? StringCast(m_tethers->Size()) : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, "Acceleration", 
+            Diagnostic::WHITE, ACCELERATION_NAMES[m_acceleration]);
+
+        renderer.UpdateText(Diagnostic::CLOTH, "AdaptiveIterations", 
+            Diagnostic::WHITE, m_adaptiveIterations ? "On" : "Off");
+
+        renderer.UpdateText(Diagnostic::CLOTH, "SleepingTiles", Diagnostic::WHITE, 
+            m_allowSleeping ? StringCast(m_particles->GetSleepingTiles()) + "/" 
+            + StringCast(m_particles->GetTileCount()) : "Off");
+
+        if(!m_stats.residuals.empty())
+        {
+            std::string residuals;
+            for(float residual : m_stats.residuals)
+            {
+                residuals += (residuals.empty() ? "" : " ") + StringCast(residual);
+            }
+            renderer.UpdateText(Diagnostic::CLOTH, "Residuals", Diagnostic::WHITE, residuals);
+
+            renderer.UpdateText(Diagnostic::CLOTH, "IterationsUsed", 
+                Diagnostic::WHITE, StringCast(m_stats.iterations));
+
+            renderer.UpdateText(Diagnostic::CLOTH, "FinalResidual", 
+                Diagnostic::WHITE, StringCast(m_stats.residual));
+
+            const double nsPerMs = 1.0e6;
+            renderer.UpdateText(Diagnostic::CLOTH, "TimeSavedMs", 
+                Diagnostic::WHITE, StringCast(m_stats.timeSaved / nsPerMs));
+        }
+
+        renderer.UpdateText(Diagnostic::CLOTH, "SolverNsPerParticle", Diagnostic::WHITE, 
+            StringCast(m_solverTimer->GetAverageTime() / m_particleCount));
+
+        renderer.UpdateText(Diagnostic::CLOTH, "SolverThreads", 
+            Diagnostic::WHITE, StringCast(m_threads->GetThreadCount()));
+
+        for(unsigned int i = 0; i < m_threadTimings.size(); ++i)
+        {
+            if(m_threadTimings[i] > 0.0)
+            {
+                const double nsPerMs = 1.0e6;
+                renderer.UpdateText(Diagnostic::CLOTH, "SolverMs" + StringCast(i+1) + "Threads",
+                    Diagnostic::WHITE, StringCast(m_threadTimings[i] / nsPerMs));
+            }
+        }
     }
 }
 
 void Cloth::Reset()
 {
-    for(const ParticlePtr& particle : m_particles)
-    {
-        particle->ResetPosition();
-    }
+    m_particles->ResetPositions();
+    m_previousPositions = m_particles->GetPositions();
     UpdateVertexBuffer();
 }
 
-Cloth::ParticlePtr& Cloth::GetParticle(int row, int column)
+int Cloth::GetParticleIndex(int row, int column) const
+{
+    return GetGridIndex(row, column, m_particleLength);
+}
+
+Particle Cloth::GetParticle(int index)
 {
-    return m_particles[(column * m_particleLength) + row];
+    return Particle(*m_particles, index);
 }
 
 void Cloth::DrawCollisions(const Matrix& projection, const Matrix& view)
 {
     if(m_drawColParticles)
     {
-        for(const ParticlePtr& particle : m_particles)
+        for(int i = 0; i < m_particleCount; ++i)
         {
-            particle->DrawCollisionMesh(projection, view);
+            GetParticle(i).DrawCollisionMesh(projection, view);
         }
     }
 
     if(m_drawVisualParticles)
     {
-        for(unsigned int i = 0; i < m_particles.size(); ++i)
+        for(int i = 0; i < m_particleCount; ++i)
         {
             // Draw visual particles at smoothed position
-            m_particles[i]->DrawVisualMesh(projection, 
+            GetParticle(i).DrawVisualMesh(projection, 
                 view, m_vertexData[i].position);
         }
     }
@@ -485,7 +1083,7 @@ bool Cloth::MousePickingTest(Picking& input)
         int indexChosen = -1;
         for(int index = 0; index < m_particleCount; ++index)
         {
-            const CollisionMesh& mesh = m_particles[index]->GetCollisionMesh();
+            const CollisionMesh& mesh = m_particles->GetCollisionMesh(index);
             const Geometry& geometry = *mesh.GetGeometry();
 
             //tweak the collision mesh to compensate for any smoothing on the cloth
@@ -512,17 +1110,28 @@ bool Cloth::MousePickingTest(Picking& input)
     return false;
 }
 
-void Cloth::SetParticleColor(const Cloth::ParticlePtr& particle)
+void Cloth::SetParticleColor(int index)
 {
-    ParticleColors color = (particle->IsPinned() ? PINNED : 
-        (particle->IsSelected() && m_handleMode ? SELECTED : NORMAL));
-    particle->SetColor(m_colors[color]);
+    Particle particle = GetParticle(index);
+    ParticleColors color = (particle.IsPinned() ? PINNED : 
+        (particle.IsSelected() && m_handleMode ? SELECTED : NORMAL));
+    particle.SetColor(m_colors[color]);
 }
 
 void Cloth::SelectParticle(int index)
 {
-    m_particles[index]->PinParticle(!m_particles[index]->IsPinned());
-    SetParticleColor(m_particles[index]);
+    Particle particle = GetParticle(index);
+    particle.PinParticle(!particle.IsPinned());
+    SetParticleColor(index);
+
+    if(particle.IsPinned())
+    {
+        m_tethers->AddPin(index);
+    }
+    else
+    {
+        m_tethers->RemovePin(index);
+    }
 }
 
 void Cloth::MovePinnedRow(float right, float up, float forward)
@@ -530,11 +1139,11 @@ void Cloth::MovePinnedRow(float right, float up, float forward)
     if(m_handleMode)
     {
         D3DXVECTOR3 direction(right, up, forward);
-        for(const ParticlePtr& particle : m_particles)
+        for(int i = 0; i < m_particleCount; ++i)
         {
-            if(particle->IsSelected())
+            if(m_particles->HasFlag(i, ParticleStore::SELECTED))
             { 
-                particle->AddForce(direction); 
+                m_particles->AddForce(i, direction); 
             } 
         }
     }
@@ -575,24 +1184,138 @@ void Cloth::ChangeRow(int row, bool select)
     for(; counter < m_particleLength; ++counter)
     {
         getIndexFn();
-        m_particles[index]->SelectParticle(select);
-        SetParticleColor(m_particles[index]);
+        GetParticle(index).SelectParticle(select);
+        SetParticleColor(index);
     }
 }
 
+void Cloth::ChangeThreadCount()
+{
+    const int threads = m_threads->GetThreadCount();
+    m_threads->SetThreadCount(threads == ThreadPool::GetMaxThreads() ? 1 : threads+1);
+    m_solverTimer->Reset();
+}
+
+void Cloth::ToggleTethers()
+{
+    m_useTethers = !m_useTethers;
+}
+
+void Cloth::ChangeAcceleration()
+{
+    m_acceleration = (m_acceleration + 1) % MAX_ACCELERATIONS;
+}
+
+void Cloth::SetRelaxation(float relaxation)
+{
+    m_relaxation = max(relaxation, 0.0f);
+}
+
+void Cloth::SetSpectralRadius(float radius)
+{
+    m_spectralRadius = max(min(radius, 0.99f), 0.0f);
+}
+
+void Cloth::ToggleAdaptiveIterations()
+{
+    m_adaptiveIterations = !m_adaptiveIterations;
+}
+
+void Cloth::ToggleMesh()
+{
+    // Rows being rebuilt would replace the mesh once swapped in
+    if(m_pendingLayout.valid())
+    {
+        return;
+    }
+
+    if(IsGrid())
+    {
+        std::string errorBuffer;
+        Assimpmesh mesh;
+        if(!mesh.Initialise(MESH_PATH, errorBuffer))
+        {
+            ShowMessageBox(errorBuffer);
+        }
+        else if(mesh.GetMeshes().empty())
+        {
+            ShowMessageBox("Cloth mesh " + MESH_PATH + " has no submeshes");
+        }
+        else
+        {
+            CreateCloth(mesh.GetMeshes()[0]);
+        }
+    }
+    else
+    {
+        CreateCloth(m_requestedRows, m_spacing);
+        if(m_handleMode)
+        {
+            ChangeRow(m_selectedRow, true);
+        }
+    }
+}
+
+void Cloth::ToggleSleeping()
+{
+    m_allowSleeping = !m_allowSleeping;
+    UpdateSleeping();
+}
+
+void Cloth::UpdateSleeping()
+{
+    // The projective solver prefactors its pins so cannot hold resting particles
+    m_particles->SetSleeping(m_allowSleeping && m_solver != PROJECTIVE);
+}
+
+void Cloth::SetSimulation(bool simulating)
+{
+    if(m_simulation != simulating)
+    {
+        m_simulation = simulating;
+        m_particles->WakeAll();
+    }
+}
+
+void Cloth::SetTolerance(float tolerance)
+{
+    m_tolerance = max(tolerance, 0.0f);
+}
+
+void Cloth::SetMinimumIterations(int iterations)
+{
+    m_minimumIterations = max(iterations, 1);
+}
+
+void Cloth::SetUseMaximumResidual(bool useMaximum)
+{
+    m_useMaximumResidual = useMaximum;
+}
+
+const SolverStats& Cloth::GetSolverStats() const
+{
+    return m_stats;
+}
+
 void Cloth::SetSpacing(double size)
 {
     if(size != m_spacing)
     {
-        CreateCloth(m_particleLength, static_cast<float>(size));
+        RescaleCloth(static_cast<float>(size));
     }
 }
 
 void Cloth::SetVertexRows(double number)
 {
-    if(number != m_particleLength)
+    const int rows = static_cast<int>(number);
+    if(rows != m_requestedRows)
     {
-        CreateCloth(static_cast<int>(number), m_spacing);
+        // Only one rebuild runs at a time, any newer request follows once it is swapped in
+        m_requestedRows = rows;
+        if(!m_pendingLayout.valid())
+        {
+            StartRebuild();
+        }
     }
 }
 
@@ -612,6 +1335,23 @@ double Cloth::GetTimeStep() const
     return m_timestep;
 }
 
+void Cloth::SetSolver(double solver)
+{
+    const int chosen = static_cast<int>(solver);
+    if(chosen != m_solver && chosen >= 0 && chosen < MAX_SOLVERS)
+    {
+        m_solver = chosen;
+        m_solverTimer->Reset();
+        UpdateSleeping();
+        std::fill(m_threadTimings.begin(), m_threadTimings.end(), 0.0);
+    }
+}
+
+double Cloth::GetSolver() const
+{
+    return m_solver;
+}
+
 double Cloth::GetIterations() const
 {
     return m_springIterations;
@@ -619,7 +1359,7 @@ double Cloth::GetIterations() const
 
 double Cloth::GetVertexRows() const
 {
-    return m_particleLength;
+    return m_requestedRows;
 }
 
 double Cloth::GetSpacing() const
@@ -627,20 +1367,28 @@ double Cloth::GetSpacing() const
     return m_spacing;
 }
 
-std::vector<Cloth::ParticlePtr>& Cloth::GetParticles()
+ParticleStore& Cloth::GetParticles()
 {
-    return m_particles;
+    return *m_particles;
 }
 
 void Cloth::PostCollisionUpdate()
 {
-    // Update the collision mesh last after all movement has been decided
-    for(const ParticlePtr& particle : m_particles)
+    m_particles->PostCollisionUpdate();
+}
+
+bool Cloth::InterpolateVertexBuffer(float interpolation)
+{
+    // A fully resting cloth only needs its vertex buffer filled once
+    const bool asleep = m_particles->IsAsleep();
+    if(asleep && m_renderedAsleep)
     {
-        particle->PostCollisionUpdate();
+        return true;
     }
 
-    UpdateVertexBuffer();
+    m_renderedAsleep = asleep;
+    m_interpolation = asleep ? 1.0f : interpolation;
+    return UpdateVertexBuffer();
 }
 
 bool Cloth::UpdateVertexBuffer()
@@ -680,27 +1428,32 @@ void Cloth::ChangeSmoothing(bool increase)
     m_generalSmoothing += increase ? SMOOTH_INCREASE : -SMOOTH_INCREASE;
     m_generalSmoothing = min(m_generalSmoothing, 1.0f);
     m_generalSmoothing = max(m_generalSmoothing, 0.0f);
+    m_renderedAsleep = false;
 }
 
 void Cloth::UpdateVertices()
 {
-    int index = -1;
     D3DXVECTOR3 normal(0.0f, 0.0f, 0.0f);
+    const auto& positions = m_particles->GetPositions();
+    const float interpolation = m_interpolation;
 
-    for(int x = 0; x < m_particleLength; ++x)
+    for(int index = 0; index < m_particleCount; ++index)
     {
-        for(int y = 0; y < m_particleLength; ++y)
-        {
-            index = (x*m_particleLength)+y;
-            m_vertexData[index].normal = normal;
-            m_vertexData[index].uvs = m_particles[index]->GetUVs();
-            m_vertexData[index].position = m_particles[index]->GetPosition();
-        }
+        m_vertexData[index].normal = normal;
+        m_vertexData[index].uvs = m_particles->GetUVs(index);
+        m_vertexData[index].position = m_previousPositions[index] + 
+            (positions[index] - m_previousPositions[index]) * interpolation;
     }
 }
 
 void Cloth::UpdateNormals()
 {
+    if(!IsGrid())
+    {
+        UpdateMeshNormals();
+        return;
+    }
+
     D3DXVECTOR3 normal;
     int p1, p2, p3, p4;
 
@@ -730,9 +1483,50 @@ void Cloth::UpdateNormals()
     }
 }
 
+void Cloth::UpdateMeshNormals()
+{
+    for(unsigned int i = 0; i < m_indexData.size(); i += POINTS_IN_FACE)
+    {
+        MeshVertex& v1 = m_vertexData[m_indexData[i]];
+        MeshVertex& v2 = m_vertexData[m_indexData[i+1]];
+        MeshVertex& v3 = m_vertexData[m_indexData[i+2]];
+
+        const D3DXVECTOR3 normal = CalculateNormal(v1.position, v2.position, v3.position);
+        v1.normal += normal;
+        v2.normal += normal;
+        v3.normal += normal;
+    }
+}
+
+void Cloth::SmoothMesh()
+{
+    D3DXVECTOR3 smoothedPosition;
+    for(int index = 0; index < m_particleCount; ++index)
+    {
+        const int begin = m_neighbourOffsets[index];
+        const int end = m_neighbourOffsets[index + 1];
+        if(begin != end && !m_particles->HasFlag(index, ParticleStore::HULL_COLLIDING))
+        {
+            MakeZeroVector(smoothedPosition);
+            for(int i = begin; i < end; ++i)
+            {
+                smoothedPosition += m_vertexData[m_neighbours[i]].position;
+            }
+            smoothedPosition /= static_cast<float>(end - begin);
+
+            m_vertexData[index].position += (smoothedPosition - 
+                m_vertexData[index].position) * m_generalSmoothing;
+        }
+    }
+}
+
 void Cloth::SmoothCloth()
 {
-    if(m_generalSmoothing > 0.0f)
+    if(m_generalSmoothing > 0.0f && !IsGrid())
+    {
+        SmoothMesh();
+    }
+    else if(m_generalSmoothing > 0.0f)
     {
         int index = -1;
         D3DXVECTOR3 halfp1, halfp2;
@@ -745,7 +1539,7 @@ void Cloth::SmoothCloth()
             for(int y = 1; y < m_particleLength-1; ++y)
             {
                 index = (x*m_particleLength)+y;
-                if(m_particles[index]->RequiresSmoothing())
+                if(!m_particles->HasFlag(index, ParticleStore::HULL_COLLIDING))
                 {
                     p1 = ((x+1)*m_particleLength)+y+1;
                     p2 = ((x+1)*m_particleLength)+y-1;
@@ -769,7 +1563,7 @@ void Cloth::SmoothCloth()
 
 void Cloth::UpdateSubdividedVertices()
 {
-    if(m_subdivideCloth)
+    if(m_subdivideCloth && IsGrid())
     {
         int quad = 0;
         int quadindex = 0;
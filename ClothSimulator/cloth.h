@@ -7,11 +7,19 @@
 #include "callbacks.h"
 #include "pickablemesh.h"
 #include "geometry.h"
+#include "solver_interface.h"
+#include "assimpmesh.h"
+
+#include <future>
 
 class Picking;
 class CollisionMesh;
 class Particle;
-class Spring;
+class ParticleStore;
+class SpringStore;
+class Stopwatch;
+class ThreadPool;
+class TetherStore;
 
 /**
 * Dynamic mesh with soft body physics
@@ -20,14 +28,28 @@ class Cloth : public PickableMesh, public Transform
 {
 public:
 
-    typedef std::unique_ptr<Particle> ParticlePtr;
-    typedef std::unique_ptr<Spring> SpringPtr;
+    /**
+    * Methods available for solving the cloth
+    */
+    enum Solver
+    {
+        SPRING,
+        XPBD,
+        IMPLICIT,
+        PROJECTIVE,
+        VBD,
+        MULTIGRID,
+        STENCIL,
+        MAX_SOLVERS
+    };
 
     /**
     * Constructor; loads the cloth mesh
     * @param engine Callbacks from the rendering engine
+    * @param instance The index of the cloth in the scene, with the first
+    *        drawing the diagnostics and each after starting above the last
     */
-    explicit Cloth(EnginePtr engine);
+    Cloth(EnginePtr engine, int instance);
 
     /**
     * Destructor
@@ -59,11 +81,17 @@ public:
     bool MousePickingTest(Picking& input);
 
     /**
-    * Updates the cloth state before collision solving
+    * Updates the cloth state before solving
     * @param deltatime The time passed since last frame in seconds
     */
     void PreCollisionUpdate(float deltatime);
 
+    /**
+    * Solves the springs and moves the particles for a single tick before collision solving
+    * @note only touches this cloth so separate cloths can be solved in parallel
+    */
+    void Solve();
+
     /**
     * Resets the cloth to its initial state
     */
@@ -72,7 +100,7 @@ public:
     /**
     * @param simulating Set whether the cloth is simulating
     */
-    void SetSimulation(bool simulating) { m_simulation = simulating; }
+    void SetSimulation(bool simulating);
 
     /**
     * @return whether the cloth is simulating
@@ -124,9 +152,37 @@ public:
     double GetTimeStep() const;
 
     /**
-    * @return the container of cloth particles
+    * Sets the method used for solving the cloth
+    * @param solver The solver to set to
+    */
+    void SetSolver(double solver);
+
+    /**
+    * @return the method used for solving the cloth
+    */
+    double GetSolver() const;
+
+    /**
+    * @return the store of cloth particles
+    */
+    ParticleStore& GetParticles();
+
+    /**
+    * @param particleA/particleB The particles to test
+    * @return whether the particles are joined by a spring and so don't collide
     */
-    std::vector<ParticlePtr>& GetParticles();
+    bool IsCollisionMasked(int particleA, int particleB) const
+    {
+        const int end = m_collisionMaskOffsets[particleA+1];
+        for(int i = m_collisionMaskOffsets[particleA]; i < end; ++i)
+        {
+            if(m_collisionMask[i] == particleB)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
     
     /**
     * @param draw Set whether the vertices are visible or not
@@ -166,6 +222,72 @@ public:
     */
     void SelectParticle(int index);
 
+    /**
+    * Cycles the number of threads used for solving the cloth
+    */
+    void ChangeThreadCount();
+
+    /**
+    * Toggles whether particles are tethered to their nearest pinned particles
+    */
+    void ToggleTethers();
+
+    /**
+    * Cycles the convergence acceleration used for spring iterations
+    * between none, over-relaxation, chebyshev and both
+    */
+    void ChangeAcceleration();
+
+    /**
+    * @param relaxation The over-relaxation of each spring correction
+    *        used when over-relaxation is active
+    */
+    void SetRelaxation(float relaxation);
+
+    /**
+    * @param radius The estimated spectral radius of the spring
+    *        iterations used when chebyshev weighting is active
+    */
+    void SetSpectralRadius(float radius);
+
+    /**
+    * Toggles whether the spring iterations stop once the residual falls under
+    * the tolerance, using the iterations set as the maximum
+    */
+    void ToggleAdaptiveIterations();
+
+    /**
+    * Toggles whether tiles of the cloth that have come
+    * to rest sleep until they are disturbed
+    */
+    void ToggleSleeping();
+
+    /**
+    * Toggles the cloth between the grid and the banner mesh
+    */
+    void ToggleMesh();
+
+    /**
+    * @param tolerance The residual to stop the spring iterations at
+    */
+    void SetTolerance(float tolerance);
+
+    /**
+    * @param iterations The fewest spring iterations when adaptive
+    */
+    void SetMinimumIterations(int iterations);
+
+    /**
+    * @param useMaximum Whether the residual is the maximum 
+    *        spring strain rather than the root mean square
+    */
+    void SetUseMaximumResidual(bool useMaximum);
+
+    /**
+    * @return the iterations, residuals and time saved last tick
+    */
+    const SolverStats& GetSolverStats() const;
+
     /**
     * Whether to increase or decrease the amount of
     * general overall smoothing for the cloth
@@ -183,8 +305,33 @@ public:
     */
     void PostCollisionUpdate();
 
+    /**
+    * Copies the vertex data blended between the last two physics ticks
+    * over to the directX vertex buffer
+    * @param interpolation The amount to blend from the previous tick to the current
+    * @return whether the call succeeded or not
+    */
+    bool InterpolateVertexBuffer(float interpolation);
+
 private:
 
+    /**
+    * Topology of the cloth grid that can be built away from the main thread
+    */
+    struct Layout
+    {
+        int rows = 0;                          ///< Number of rows the layout is for or 0 if a mesh
+        float spacing = 0.0f;                  ///< Spacing the spring rest lengths are for
+        int springCount = 0;                   ///< Number of springs in the layout
+        int quadVertices = 0;                  ///< Number of vertices that center each quad
+        std::unique_ptr<SpringStore> springs;  ///< Springs connecting the particles together
+        std::vector<DWORD> indices;            ///< DirectX Index data
+        std::vector<D3DXVECTOR3> positions;    ///< Initial positions of a mesh
+        std::vector<D3DXVECTOR2> uvs;          ///< Texture uvs of a mesh
+        std::vector<int> neighbourOffsets;     ///< Offsets into the neighbours for each mesh particle
+        std::vector<std::uint32_t> neighbours; ///< Particles sharing an edge with each interior particle
+    };
+
     /**
     * Recreates the cloth
     * @param rows The number of rows for the cloth
@@ -192,11 +339,95 @@ private:
     */
     void CreateCloth(int rows, float spacing);
 
+    /**
+    * Recreates the cloth from a triangle mesh
+    * @param mesh The submesh to simulate
+    */
+    void CreateCloth(const Assimpmesh::SubMesh& mesh);
+
+    /**
+    * Scales the cloth in place without changing its grid
+    * @param spacing The spacing between vertices
+    */
+    void RescaleCloth(float spacing);
+
+    /**
+    * Resizes the cloth to a new layout, keeping the particles still in the grid
+    * @param layout The layout to swap in
+    */
+    void ResizeCloth(Layout& layout);
+
+    /**
+    * Swaps in the springs and indices of a layout and recreates the mesh
+    * @param layout The layout to swap in, left holding the previous data
+    */
+    void ApplyLayout(Layout& layout);
+
+    /**
+    * Finds the particles joined to each particle by a spring
+    */
+    void UpdateCollisionMask();
+
+    /**
+    * Builds the springs and indices for a cloth grid
+    * @param rows The number of rows for the cloth
+    * @param spacing The spacing between vertices
+    * @param subdivide Whether the cloth is subdivided
+    * @param origin The initial position for the center of the cloth
+    * @return the built layout
+    * @note uses no cloth state so can run on a background thread
+    */
+    static std::unique_ptr<Layout> BuildLayout(int rows, 
+                                               float spacing, 
+                                               bool subdivide, 
+                                               const D3DXVECTOR3& origin);
+
+    /**
+    * Builds the springs and indices for a triangle mesh, welding vertices that
+    * share a position. Stretch springs join the ends of each edge and bend springs
+    * join the vertices opposite each edge shared by two triangles. Particles are
+    * ordered breadth first across the edges so neighbours are close in memory.
+    * @param mesh The submesh to build from
+    * @param spacing The average distance between neighbouring particles to scale to
+    * @param origin The initial position for the center of the cloth
+    * @param errorBuffer The error buffer to fill if something fails
+    * @return the built layout or null if the mesh can't be simulated
+    */
+    static std::unique_ptr<Layout> BuildMeshLayout(const Assimpmesh::SubMesh& mesh, 
+                                                   float spacing,
+                                                   const D3DXVECTOR3& origin,
+                                                   std::string& errorBuffer);
+
+    /**
+    * Builds the layout for the requested rows on a background thread
+    */
+    void StartRebuild();
+
+    /**
+    * Swaps in the layout built on the background thread once ready
+    */
+    void UpdateRebuild();
+
+    /**
+    * Updates the particle grid and collision scale from the spacing
+    */
+    void UpdateScale();
+
     /**
     * Draws and updates the diagnostics for the cloth
     */
     void UpdateDiagnostics();
 
+    /**
+    * @return whether the cloth is a grid rather than a mesh
+    */
+    bool IsGrid() const { return m_particleLength > 0; }
+
+    /**
+    * Allows the particles to sleep if enabled and supported by the solver
+    */
+    void UpdateSleeping();
+
     /**
     * Smooths the cloth vertices
     */
@@ -207,6 +438,16 @@ private:
     */
     void UpdateNormals();
 
+    /**
+    * Updates the cloth normals from the triangles of a mesh
+    */
+    void UpdateMeshNormals();
+
+    /**
+    * Smooths the interior vertices of a mesh towards their neighbours
+    */
+    void SmoothMesh();
+
     /**
     * Updates all generic vertices of the cloth
     */
@@ -231,9 +472,15 @@ private:
 
     /**
     * @param row/column The row and column of the required particle
-    * @return the particle in grid at row/col
+    * @return the index of the particle in grid at row/col
     */
-    ParticlePtr& GetParticle(int row, int column);
+    int GetParticleIndex(int row, int column) const;
+
+    /**
+    * @param index The index of the required particle
+    * @return a view of the particle
+    */
+    Particle GetParticle(int index);
 
     /**
     * Creates a normal from the given three particles
@@ -245,16 +492,9 @@ private:
                                 const D3DXVECTOR3& p3);
     
     /**
-    * Adds a force to the given particle
-    * @param particle Particle to add the force to
-    * @param force The force to add
-    */
-    void AddForce(const ParticlePtr& particle, const D3DXVECTOR3& force);
-
-    /**
-    * @param particle The particle to set the color for
+    * @param index The index of the particle to set the color for
     */
-    void SetParticleColor(const ParticlePtr& particle);
+    void SetParticleColor(int index);
 
     /**
     * Prevent copying
@@ -269,6 +509,7 @@ private:
     float m_timestepSquared;    ///< Cloth timestep squared
     float m_damping;            ///< Damping to apply to movement of particles
     int m_springCount;          ///< Number of springs in cloth
+    int m_requestedRows;        ///< Number of rows the cloth is being rebuilt to
     int m_springIterations;     ///< Number of solver iterations per tick
     int m_particleLength;       ///< Number of particles in a row/column
     int m_particleCount;        ///< Overall number of particles in the cloth
@@ -282,15 +523,41 @@ private:
     D3DXVECTOR3 m_gravity;      ///< Simulated Gravity of the cloth
     float m_generalSmoothing;   ///< General overall smoothing of the cloth
     int m_diagnosticParticle;   ///< Particle for rendering diagnostics
-
-    EnginePtr m_engine;                           ///< Callbacks for the rendering engine
-    std::vector<D3DXVECTOR3> m_colors;            ///< Viable colors for the particles
-    std::vector<SpringPtr> m_springs;             ///< Springs connecting particles together
-    std::vector<ParticlePtr> m_particles;         ///< Particles across the cloth grid
-    std::vector<MeshVertex> m_vertexData;         ///< DirectX Vertex data
-    std::vector<DWORD> m_indexData;               ///< DirectX Index data
-    std::shared_ptr<CollisionMesh> m_template;    ///< Template collision for all particles
-    LPD3DXMESH m_mesh;                            ///< Directx geometry mesh
-    LPDIRECT3DTEXTURE9 m_texture;                 ///< The texture attached to the mesh
-    LPD3DXEFFECT m_shader;                        ///< The shader attached to the mesh
+    int m_solver;               ///< Current method used for solving the cloth
+    bool m_useTethers;          ///< Whether particles are tethered to the pinned particles
+    int m_acceleration;         ///< Convergence acceleration for spring iterations
+    float m_relaxation;         ///< Over-relaxation of each spring correction
+    float m_spectralRadius;     ///< Estimated spectral radius for chebyshev weighting
+    bool m_adaptiveIterations;  ///< Whether spring iterations stop once under the tolerance
+    float m_tolerance;          ///< Residual to stop the spring iterations at
+    int m_minimumIterations;    ///< Fewest spring iterations when adaptive
+    bool m_useMaximumResidual;  ///< Whether the residual is the maximum rather than rms strain
+    float m_interpolation;      ///< Amount to blend from the previous tick when rendering
+    bool m_allowSleeping;       ///< Whether resting tiles of the cloth can sleep
+    bool m_renderedAsleep;      ///< Whether the vertex buffer holds the fully resting cloth
+    bool m_primary;             ///< Whether this is the first cloth which draws the diagnostics
+
+    EnginePtr m_engine;                                   ///< Callbacks for the rendering engine
+    D3DXVECTOR3 m_startPosition;                          ///< Initial position for the center of the cloth
+    std::vector<D3DXVECTOR3> m_colors;                    ///< Viable colors for the particles
+    std::unique_ptr<SpringStore> m_springs;               ///< Springs connecting particles together
+    std::unique_ptr<ParticleStore> m_particles;           ///< Particles across the cloth grid
+    std::unique_ptr<TetherStore> m_tethers;               ///< Long range attachments to pinned particles
+    std::vector<MeshVertex> m_vertexData;                 ///< DirectX Vertex data
+    std::vector<DWORD> m_indexData;                       ///< DirectX Index data
+    std::shared_ptr<CollisionMesh> m_template;            ///< Template collision for all particles
+    LPD3DXMESH m_mesh;                                    ///< Directx geometry mesh
+    LPDIRECT3DTEXTURE9 m_texture;                         ///< The texture attached to the mesh
+    LPD3DXEFFECT m_shader;                                ///< The shader attached to the mesh
+    std::unique_ptr<Stopwatch> m_solverTimer;             ///< Profiling for the cloth solver
+    std::unique_ptr<ThreadPool> m_threads;                ///< Threads for solving independent springs
+    std::vector<double> m_threadTimings;                  ///< Solver time for each thread count
+    SolverStats m_stats;                                  ///< Results of the solver last tick
+    std::vector<D3DXVECTOR3> m_previousPositions;         ///< Particle positions before the last tick
+    std::vector<std::unique_ptr<ISolver>> m_solvers;      ///< Available methods for solving the cloth
+    std::future<std::unique_ptr<Layout>> m_pendingLayout; ///< Layout being built on a background thread
+    std::vector<int> m_neighbourOffsets;                  ///< Offsets into the neighbours for each mesh particle
+    std::vector<std::uint32_t> m_neighbours;              ///< Particles smoothed towards for a mesh
+    std::vector<int> m_collisionMaskOffsets;              ///< Offsets into the collision mask for each particle
+    std::vector<int> m_collisionMask;                     ///< Particles joined by a spring to each particle
 };
\ No newline at end of file
@@ -21,6 +21,7 @@ CollisionMesh::CollisionMesh(EnginePtr engine, const Transform* parent)
     , m_parent(parent)
     , m_partition(nullptr)
     , m_positionDelta(0.0f, 0.0f, 0.0f)
+    , m_tickPosition(0.0f, 0.0f, 0.0f)
     , m_velocity(0.0f, 0.0f, 0.0f)
     , m_colour(1.0f, 1.0f, 1.0f)
     , m_geometry(nullptr)
@@ -134,6 +135,7 @@ void CollisionMesh::Initialise(bool createmesh,
         scale = FindLocalScale();
     }
     LoadCollisionModel(scale);
+    SaveTickPosition();
 }
 
 void CollisionMesh::LoadInstance(const CollisionMesh& mesh)
@@ -203,6 +205,63 @@ const std::vector<D3DXVECTOR3>& CollisionMesh::GetVertices() const
     return m_worldVertices;
 }
 
+D3DXVECTOR3 CollisionMesh::GetSupportPoint(const D3DXVECTOR3& direction) const
+{
+    // The shapes are unit shapes transformed by the world matrix, so the 
+    // direction is taken into local space to find the furthest local point
+    const D3DXVECTOR3 right(m_world.Right());
+    const D3DXVECTOR3 up(m_world.Up());
+    const D3DXVECTOR3 forward(m_world.Forward());
+    D3DXVECTOR3 local(D3DXVec3Dot(&right, &direction),
+        D3DXVec3Dot(&up, &direction), D3DXVec3Dot(&forward, &direction));
+
+    switch(GetShape())
+    {
+    case Geometry::SPHERE:
+        {
+            const float length = D3DXVec3Length(&local);
+            local = length > 0.0f ? local / length : local;
+            break;
+        }
+    case Geometry::BOX:
+        {
+            const float halfSize = 0.5f;
+            local.x = local.x < 0.0f ? -halfSize : halfSize;
+            local.y = local.y < 0.0f ? -halfSize : halfSize;
+            local.z = local.z < 0.0f ? -halfSize : halfSize;
+            break;
+        }
+    case Geometry::CYLINDER:
+        {
+            // The cylinder has a radius of one around its forward axis
+            const float halfLength = 0.5f;
+            const float length = std::sqrt((local.x * local.x) + (local.y * local.y));
+            local.x = length > 0.0f ? local.x / length : 0.0f;
+            local.y = length > 0.0f ? local.y / length : 0.0f;
+            local.z = local.z < 0.0f ? -halfLength : halfLength;
+            break;
+        }
+    default:
+        {
+            // Any other geometry has no closed form so the vertices are searched
+            int furthestIndex = 0;
+            float furthestDot = D3DXVec3Dot(&m_worldVertices[furthestIndex], &direction);
+            for(unsigned int i = 1; i < m_worldVertices.size(); ++i)
+            {
+                const float dot = D3DXVec3Dot(&m_worldVertices[i], &direction);
+                if(dot > furthestDot)
+                {
+                    furthestDot = dot;
+                    furthestIndex = i;
+                }
+            }
+            return m_worldVertices[furthestIndex];
+        }
+    }
+
+    return m_position + (right * local.x) + (up * local.y) + (forward * local.z);
+}
+
 void CollisionMesh::DrawDiagnostics()
 {
     if(m_draw && m_geometry &&
@@ -429,6 +488,16 @@ const D3DXVECTOR3& CollisionMesh::GetVelocity() const
     return m_velocity;
 }
 
+void CollisionMesh::SaveTickPosition()
+{
+    m_tickPosition = m_position;
+}
+
+D3DXVECTOR3 CollisionMesh::GetTickMovement() const
+{
+    return m_position - m_tickPosition;
+}
+
 const D3DXVECTOR3& CollisionMesh::GetInteractingVelocity() const
 {
     throw std::exception("CollisionMesh::GetInteractingVelocity not implemented");
@@ -171,11 +171,29 @@ public:
     */
     const std::vector<D3DXVECTOR3>& GetVertices() const;
 
+    /**
+    * Finds the furthest point of the collision shape along a direction from its 
+    * world transform, without depending on how finely the geometry is divided
+    * @param direction The direction to search along
+    * @return the furthest point in world coordinates
+    */
+    D3DXVECTOR3 GetSupportPoint(const D3DXVECTOR3& direction) const;
+
     /**
     * @return the velocity for the collision mesh
     */
     const D3DXVECTOR3& GetVelocity() const;
 
+    /**
+    * Saves the current position as where the next swept collision starts from
+    */
+    void SaveTickPosition();
+
+    /**
+    * @return the change in position since the tick position was last saved
+    */
+    D3DXVECTOR3 GetTickMovement() const;
+
     /**
     * @return the velocity for the interacting collision meshes
     * @throw only updated for dynamic meshes
@@ -277,6 +295,7 @@ protected:
     Transform m_world;                         ///< World transform of the collision geometry
     Partition* m_partition;                    ///< Partition collision currently in
     D3DXVECTOR3 m_positionDelta;               ///< Change in position this tick
+    D3DXVECTOR3 m_tickPosition;                ///< Position swept collisions start from
     D3DXVECTOR3 m_velocity;                    ///< Velocity for the collision mesh
     D3DXVECTOR3 m_colour;                      ///< Colour to render
     D3DXVECTOR3 m_position;                    ///< Cached position of collision geometry
@@ -3,36 +3,526 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 
 #include "collisionsolver.h"
-#include "particle.h"
+#include "particlestore.h"
+#include "dynamicmesh.h"
 #include "cloth.h"
 #include "simplex.h"
+#include "spatialhash.h"
+#include "threadpool.h"
+#include "timer.h"
 
 #include <assert.h>
+#include <algorithm>
 
-CollisionSolver::CollisionSolver(std::shared_ptr<Engine> engine, 
-                                 std::shared_ptr<Cloth> cloth)
-    : m_cloth(cloth)
-    , m_engine(engine)
+namespace
 {
+    const int MIN_PARTICLES_PER_THREAD = 256; ///< Fewest particles worth giving their own thread
+    const float SKIN_SCALE = 0.5f;            ///< Skin around each particle as a fraction of its radius
+    const float MIN_SWEEP_SPEED = 1.0e-6f;    ///< Speed along an axis below which a sweep is parallel
+    const float CORE_TOLERANCE = 1.0e-3f;     ///< Fraction of the radius the core distance is found within
+    const int MAX_CORE_ITERATIONS = 20;       ///< Most points the core search adds before stopping
+
+    /**
+    * Finds when a moving sphere first touches a sphere
+    * @param start The position of the moving sphere at the start of the tick
+    * @param movement The movement of the sphere over the tick
+    * @param center The center of the sphere to sweep against
+    * @param radius The radius of both spheres added together
+    * @param time Filled with the fraction of the tick the spheres touch at
+    * @return whether the spheres start apart and touch during the tick
+    */
+    bool GetSphereTimeOfImpact(const D3DXVECTOR3& start,
+                               const D3DXVECTOR3& movement,
+                               const D3DXVECTOR3& center,
+                               float radius,
+                               float& time)
+    {
+        const D3DXVECTOR3 toStart = start - center;
+        const float a = D3DXVec3LengthSq(&movement);
+        const float b = 2.0f * D3DXVec3Dot(&toStart, &movement);
+        const float c = D3DXVec3LengthSq(&toStart) - (radius * radius);
+
+        // Overlapping or separating spheres are left to the discrete solver
+        const float discriminant = (b * b) - (4.0f * a * c);
+        if(c <= 0.0f || b >= 0.0f || discriminant < 0.0f)
+        {
+            return false;
+        }
+
+        time = (-b - std::sqrt(discriminant)) / (2.0f * a);
+        return time <= 1.0f;
+    }
+
+    /**
+    * Clips the times a moving point is within a slab of space
+    * @param origin The distance of the point from the center of the slab at the start
+    * @param speed The movement of the point across the slab over the tick
+    * @param extent The distance from the center of the slab to either side
+    * @param enter/exit The times the point is inside all slabs so far to clip
+    * @return whether the point is inside the slab at some time within the range
+    */
+    bool ClipSlab(float origin, float speed, float extent, float& enter, float& exit)
+    {
+        if(fabs(speed) < MIN_SWEEP_SPEED)
+        {
+            return fabs(origin) < extent;
+        }
+
+        float slabEnter = (-extent - origin) / speed;
+        float slabExit = (extent - origin) / speed;
+        if(slabEnter > slabExit)
+        {
+            std::swap(slabEnter, slabExit);
+        }
+
+        enter = max(enter, slabEnter);
+        exit = min(exit, slabExit);
+        return enter <= exit;
+    }
+
+    /**
+    * Finds when a moving sphere first touches a box
+    * @param start The position of the sphere at the start of the tick
+    * @param movement The movement of the sphere over the tick
+    * @param box The world matrix of the unit box
+    * @param radius The radius of the sphere
+    * @param time Filled with the fraction of the tick the sphere touches at
+    * @return whether the sphere starts outside the box and touches it during the tick
+    * @note the box is grown by the radius, touching slightly early around the corners
+    */
+    bool GetBoxTimeOfImpact(const D3DXVECTOR3& start,
+                            const D3DXVECTOR3& movement,
+                            const Matrix& box,
+                            float radius,
+                            float& time)
+    {
+        const D3DXVECTOR3 axes[] = { box.Right(), box.Up(), box.Forward() };
+        const D3DXVECTOR3 toStart = start - box.Position();
+
+        float enter = 0.0f;
+        float exit = 1.0f;
+        bool inside = true;
+
+        for(const D3DXVECTOR3& axis : axes)
+        {
+            // Each axis is scaled by the size of the box along it
+            const float length = D3DXVec3Length(&axis);
+            const float extent = (length * 0.5f) + radius;
+            const float origin = D3DXVec3Dot(&axis, &toStart) / length;
+            inside &= fabs(origin) < extent;
+
+            if(!ClipSlab(origin, D3DXVec3Dot(&axis, &movement) / length, extent, enter, exit))
+            {
+                return false;
+            }
+        }
+
+        time = enter;
+        return !inside;
+    }
+
+    /**
+    * Finds when a moving sphere first touches a cylinder
+    * @param start The position of the sphere at the start of the tick
+    * @param movement The movement of the sphere over the tick
+    * @param cylinder The world matrix of the unit cylinder along its forward axis
+    * @param radius The radius of the sphere
+    * @param time Filled with the fraction of the tick the sphere touches at
+    * @return whether the sphere starts outside the cylinder and touches it during the tick
+    * @note the cylinder is grown by the radius and any elliptical 
+    *        cylinder is swept as the circular cylinder around it
+    */
+    bool GetCylinderTimeOfImpact(const D3DXVECTOR3& start,
+                                 const D3DXVECTOR3& movement,
+                                 const Matrix& cylinder,
+                                 float radius,
+                                 float& time)
+    {
+        const D3DXVECTOR3 right(cylinder.Right());
+        const D3DXVECTOR3 up(cylinder.Up());
+        const D3DXVECTOR3 forward(cylinder.Forward());
+
+        const float length = D3DXVec3Length(&forward);
+        const float extent = (length * 0.5f) + radius;
+        const float cylinderRadius = radius + 
+            max(D3DXVec3Length(&right), D3DXVec3Length(&up));
+
+        // Split the movement into along and around the cylinder axis
+        const D3DXVECTOR3 axis = forward / length;
+        const D3DXVECTOR3 toStart = start - cylinder.Position();
+        const float origin = D3DXVec3Dot(&axis, &toStart);
+        const float speed = D3DXVec3Dot(&axis, &movement);
+        const D3DXVECTOR3 radial = toStart - (axis * origin);
+        const D3DXVECTOR3 radialMovement = movement - (axis * speed);
+
+        const float a = D3DXVec3LengthSq(&radialMovement);
+        const float b = 2.0f * D3DXVec3Dot(&radial, &radialMovement);
+        const float c = D3DXVec3LengthSq(&radial) - (cylinderRadius * cylinderRadius);
+
+        // Overlapping particles are left to the discrete solver
+        if(c < 0.0f && fabs(origin) < extent)
+        {
+            return false;
+        }
+
+        float enter = 0.0f;
+        float exit = 1.0f;
+        if(!ClipSlab(origin, speed, extent, enter, exit))
+        {
+            return false;
+        }
+
+        // Clip to the times inside the infinite cylinder
+        if(a < MIN_SWEEP_SPEED)
+        {
+            if(c >= 0.0f)
+            {
+                return false;
+            }
+        }
+        else
+        {
+            const float discriminant = (b * b) - (4.0f * a * c);
+            if(discriminant < 0.0f)
+            {
+                return false;
+            }
+
+            const float root = std::sqrt(discriminant);
+            enter = max(enter, (-b - root) / (2.0f * a));
+            exit = min(exit, (-b + root) / (2.0f * a));
+        }
+
+        time = enter;
+        return enter <= exit;
+    }
+
+    /**
+    * Finds how far a sphere must move to stop overlapping a box
+    * @param center The center of the sphere
+    * @param box The world matrix of the unit box
+    * @param radius The radius of the sphere
+    * @param translation Filled with the movement that separates the sphere from the box
+    * @return whether the sphere overlaps the box
+    */
+    bool GetBoxPenetration(const D3DXVECTOR3& center,
+                           const Matrix& box,
+                           float radius,
+                           D3DXVECTOR3& translation)
+    {
+        const D3DXVECTOR3 axes[] = { box.Right(), box.Up(), box.Forward() };
+        const D3DXVECTOR3 toCenter = center - box.Position();
+
+        // Clamp the center to the box along each axis
+        D3DXVECTOR3 fromSurface(0.0f, 0.0f, 0.0f);
+        float depth = FLT_MAX;
+        D3DXVECTOR3 exitDirection(0.0f, 0.0f, 0.0f);
+
+        for(const D3DXVECTOR3& axis : axes)
+        {
+            // Each axis is scaled by the size of the box along it
+            const float length = D3DXVec3Length(&axis);
+            const float extent = length * 0.5f;
+            const float origin = D3DXVec3Dot(&axis, &toCenter) / length;
+            const float clamped = max(-extent, min(extent, origin));
+            fromSurface += axis * ((origin - clamped) / length);
+
+            const float axisDepth = extent - fabs(origin);
+            if(axisDepth < depth)
+            {
+                depth = axisDepth;
+                exitDirection = axis * ((origin < 0.0f ? -1.0f : 1.0f) / length);
+            }
+        }
+
+        const float distanceSqr = D3DXVec3LengthSq(&fromSurface);
+        if(distanceSqr >= radius * radius)
+        {
+            return false;
+        }
+        else if(distanceSqr > 0.0f)
+        {
+            const float distance = std::sqrt(distanceSqr);
+            translation = fromSurface * ((radius - distance) / distance);
+        }
+        else
+        {
+            // Centers inside the box leave through the closest face
+            translation = exitDirection * (depth + radius);
+        }
+        return true;
+    }
+
+    /**
+    * Finds how far a sphere must move to stop overlapping a cylinder
+    * @param center The center of the sphere
+    * @param cylinder The world matrix of the unit cylinder along its forward axis
+    * @param radius The radius of the sphere
+    * @param translation Filled with the movement that separates the sphere from the cylinder
+    * @return whether the sphere overlaps the cylinder
+    * @note cylinders are always scaled uniformly across their right and up axis
+    */
+    bool GetCylinderPenetration(const D3DXVECTOR3& center,
+                                const Matrix& cylinder,
+                                float radius,
+                                D3DXVECTOR3& translation)
+    {
+        const D3DXVECTOR3 right(cylinder.Right());
+        const D3DXVECTOR3 forward(cylinder.Forward());
+        const float cylinderRadius = D3DXVec3Length(&right);
+        const float length = D3DXVec3Length(&forward);
+        const float halfLength = length * 0.5f;
+        const D3DXVECTOR3 axis = forward / length;
+
+        // Split the center into its distance along the axis and away from it
+        const D3DXVECTOR3 toCenter = center - cylinder.Position();
+        const float axial = D3DXVec3Dot(&axis, &toCenter);
+        const D3DXVECTOR3 radial = toCenter - (axis * axial);
+        const float radialLength = D3DXVec3Length(&radial);
+
+        // Clamp the center to the cylinder
+        D3DXVECTOR3 fromSurface = axis * (axial - max(-halfLength, min(halfLength, axial)));
+        if(radialLength > cylinderRadius)
+        {
+            fromSurface += radial * ((radialLength - cylinderRadius) / radialLength);
+        }
+
+        const float distanceSqr = D3DXVec3LengthSq(&fromSurface);
+        if(distanceSqr >= radius * radius)
+        {
+            return false;
+        }
+        else if(distanceSqr > 0.0f)
+        {
+            const float distance = std::sqrt(distanceSqr);
+            translation = fromSurface * ((radius - distance) / distance);
+            return true;
+        }
+
+        // Centers inside the cylinder leave through the closest cap or the side
+        const float capDepth = halfLength - fabs(axial);
+        const float sideDepth = cylinderRadius - radialLength;
+        if(capDepth < sideDepth || radialLength == 0.0f)
+        {
+            translation = axis * ((axial < 0.0f ? -1.0f : 1.0f) * (capDepth + radius));
+        }
+        else
+        {
+            translation = radial * ((sideDepth + radius) / radialLength);
+        }
+        return true;
+    }
+
+    /**
+    * Finds the closest point on a line simplex to the origin and 
+    * removes any point not needed to describe the closest point
+    * @param points The points of the simplex
+    * @param count The number of points in the simplex
+    * @return the closest point to the origin
+    */
+    D3DXVECTOR3 ReduceLineSimplex(D3DXVECTOR3* points, int& count)
+    {
+        const D3DXVECTOR3& a = points[0];
+        const D3DXVECTOR3 ab = points[1] - a;
+        const float t = -D3DXVec3Dot(&a, &ab);
+        const float lengthSqr = D3DXVec3LengthSq(&ab);
+
+        if(t <= 0.0f || lengthSqr == 0.0f)
+        {
+            count = 1;
+            return points[0];
+        }
+        else if(t >= lengthSqr)
+        {
+            points[0] = points[1];
+            count = 1;
+            return points[0];
+        }
+        return a + (ab * (t / lengthSqr));
+    }
+
+    /**
+    * Finds the closest point on a triangle simplex to the origin and 
+    * removes any point not needed to describe the closest point
+    * Reference from 'Real-Time Collision Detection' by Christer Ericson
+    * @param points The points of the simplex
+    * @param count The number of points in the simplex
+    * @return the closest point to the origin
+    */
+    D3DXVECTOR3 ReduceTriangleSimplex(D3DXVECTOR3* points, int& count)
+    {
+        const D3DXVECTOR3 a = points[0];
+        const D3DXVECTOR3 b = points[1];
+        const D3DXVECTOR3 c = points[2];
+        const D3DXVECTOR3 ab = b - a;
+        const D3DXVECTOR3 ac = c - a;
+
+        const float d1 = -D3DXVec3Dot(&ab, &a);
+        const float d2 = -D3DXVec3Dot(&ac, &a);
+        if(d1 <= 0.0f && d2 <= 0.0f)
+        {
+            count = 1;
+            return a;
+        }
+
+        const float d3 = -D3DXVec3Dot(&ab, &b);
+        const float d4 = -D3DXVec3Dot(&ac, &b);
+        if(d3 >= 0.0f && d4 <= d3)
+        {
+            points[0] = b;
+            count = 1;
+            return b;
+        }
+
+        const float vc = (d1 * d4) - (d3 * d2);
+        if(vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            count = 2;
+            return a + (ab * (d1 / (d1 - d3)));
+        }
+
+        const float d5 = -D3DXVec3Dot(&ab, &c);
+        const float d6 = -D3DXVec3Dot(&ac, &c);
+        if(d6 >= 0.0f && d5 <= d6)
+        {
+            points[0] = c;
+            count = 1;
+            return c;
+        }
+
+        const float vb = (d5 * d2) - (d1 * d6);
+        if(vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            points[1] = c;
+            count = 2;
+            return a + (ac * (d2 / (d2 - d6)));
+        }
+
+        const float va = (d3 * d6) - (d5 * d4);
+        if(va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+            points[0] = c;
+            count = 2;
+            return b + ((c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6))));
+        }
+
+        const float denominator = 1.0f / (va + vb + vc);
+        return a + (ab * (vb * denominator)) + (ac * (vc * denominator));
+    }
+
+    /**
+    * Finds the closest point on a tetrahedron simplex to the origin and 
+    * removes any point not needed to describe the closest point
+    * @param points The points of the simplex
+    * @param count The number of points in the simplex
+    * @return the closest point to the origin, which is left 
+    *         with all four points when the origin is inside
+    */
+    D3DXVECTOR3 ReduceTetrahedronSimplex(D3DXVECTOR3* points, int& count)
+    {
+        // Each face is tested with the point opposite it last
+        const int faces[4][4] = { {0,1,2,3}, {0,2,3,1}, {0,3,1,2}, {1,3,2,0} };
+
+        D3DXVECTOR3 closestPoint(0.0f, 0.0f, 0.0f);
+        D3DXVECTOR3 closestFace[3];
+        int closestCount = 0;
+        float closestDistance = FLT_MAX;
+        
+        for(const auto& face : faces)
+        {
+            const D3DXVECTOR3& a = points[face[0]];
+            const D3DXVECTOR3 ab = points[face[1]] - a;
+            const D3DXVECTOR3 ac = points[face[2]] - a;
+            const D3DXVECTOR3 ad = points[face[3]] - a;
+
+            D3DXVECTOR3 normal;
+            D3DXVec3Cross(&normal, &ab, &ac);
+            const float originSide = -D3DXVec3Dot(&a, &normal);
+            const float oppositeSide = D3DXVec3Dot(&ad, &normal);
+
+            // Only faces with the origin in front of them can hold the closest point
+            if(originSide * oppositeSide < 0.0f || oppositeSide == 0.0f)
+            {
+                D3DXVECTOR3 facePoints[3] = { a, points[face[1]], points[face[2]] };
+                int faceCount = 3;
+                const D3DXVECTOR3 point = ReduceTriangleSimplex(facePoints, faceCount);
+                const float distance = D3DXVec3LengthSq(&point);
+                if(distance < closestDistance)
+                {
+                    closestDistance = distance;
+                    closestPoint = point;
+                    closestCount = faceCount;
+                    std::copy(facePoints, facePoints + faceCount, closestFace);
+                }
+            }
+        }
+
+        if(closestCount > 0)
+        {
+            std::copy(closestFace, closestFace + closestCount, points);
+            count = closestCount;
+        }
+        return closestPoint;
+    }
+
+    /**
+    * Finds the closest point on a simplex to the origin and 
+    * removes any point not needed to describe the closest point
+    * @param points The points of the simplex
+    * @param count The number of points in the simplex
+    * @return the closest point to the origin
+    */
+    D3DXVECTOR3 ReduceSimplex(D3DXVECTOR3* points, int& count)
+    {
+        switch(count)
+        {
+        case 2:
+            return ReduceLineSimplex(points, count);
+        case 3:
+            return ReduceTriangleSimplex(points, count);
+        case 4:
+            return ReduceTetrahedronSimplex(points, count);
+        default:
+            return points[0];
+        }
+    }
+}
+
+CollisionSolver::CollisionSolver(std::shared_ptr<Engine> engine)
+    : m_engine(engine)
+    , m_broadphase(new SpatialHash())
+    , m_threads(new ThreadPool(ThreadPool::GetMaxThreads()))
+    , m_hullTimer(new Stopwatch())
+    , m_simplex(new Simplex())
+{
+    m_neighbours.resize(m_threads->GetThreadCount());
+    m_neighbourPairs.resize(m_threads->GetThreadCount());
+    m_corrections.resize(m_threads->GetThreadCount());
 }
 
 CollisionSolver::~CollisionSolver() = default;
 
-void CollisionSolver::SolveParticleCollision(CollisionMesh& particleA, 
-                                             CollisionMesh& particleB)
+void CollisionSolver::SetCloths(const std::vector<std::shared_ptr<Cloth>>& cloths)
+{
+    m_cloths.assign(cloths.begin(), cloths.end());
+}
+
+bool CollisionSolver::GetParticleCollision(const D3DXVECTOR3& positionA,
+                                           const D3DXVECTOR3& positionB,
+                                           float combinedRadius,
+                                           D3DXVECTOR3& translation) const
 {
-    D3DXVECTOR3 particleToParticle = particleB.GetPosition() - particleA.GetPosition();
+    D3DXVECTOR3 particleToParticle = positionB - positionA;
     const float lengthSqr = D3DXVec3LengthSq(&particleToParticle);
-    const float combinedRadius = particleA.GetRadius() + particleB.GetRadius();
 
     if (lengthSqr < (combinedRadius*combinedRadius))
     {
         const float length = std::sqrt(lengthSqr);
         particleToParticle /= std::sqrt(length);
-        const D3DXVECTOR3 translation = particleToParticle*fabs(combinedRadius-length);
-        particleA.ResolveCollision(-translation);
-        particleB.ResolveCollision(translation);
+        translation = particleToParticle*fabs(combinedRadius-length);
+        return true;
     }
+    return false;
 }
 
 void CollisionSolver::SolveParticleHullCollision(CollisionMesh& particle, 
@@ -46,14 +536,112 @@ void CollisionSolver::SolveParticleHullCollision(CollisionMesh& particle,
 
     if (lengthSqr < (combinedRadius*combinedRadius))
     {
-        Simplex simplex;
-        if(AreConvexHullsColliding(particle, hull, simplex))
+        m_hullTimer->Start();
+
+        // Use the cheapest test able to solve the pair before the full search
+        const bool solved = (m_closedFormHulls && SolveParticleShapeCollision(particle, hull)) ||
+            (m_coreShapes && SolveParticleCoreCollision(particle, hull));
+
+        if(!solved)
+        {
+            Simplex& simplex = *m_simplex;
+            simplex.Clear();
+            if(AreConvexHullsColliding(particle, hull, simplex))
+            {
+                simplex.GenerateFaces();
+                const D3DXVECTOR3 penetration = GetConvexHullPenetration(particle, hull, simplex);
+                particle.ResolveCollision(penetration, hull.GetVelocity(), hull.GetShape());
+            }
+        }
+
+        m_hullTimer->Stop();
+    }
+}
+
+bool CollisionSolver::SolveParticleShapeCollision(CollisionMesh& particle, 
+                                                  const CollisionMesh& hull)
+{
+    D3DXVECTOR3 translation;
+    bool colliding = false;
+    switch(hull.GetShape())
+    {
+    case Geometry::BOX:
+        colliding = GetBoxPenetration(particle.GetPosition(), 
+            hull.CollisionMatrix(), particle.GetRadius(), translation);
+        break;
+    case Geometry::CYLINDER:
+        colliding = GetCylinderPenetration(particle.GetPosition(), 
+            hull.CollisionMatrix(), particle.GetRadius(), translation);
+        break;
+    default:
+        return false;
+    }
+
+    if(colliding)
+    {
+        particle.ResolveCollision(translation, hull.GetVelocity(), hull.GetShape());
+    }
+    return true;
+}
+
+bool CollisionSolver::SolveParticleCoreCollision(CollisionMesh& particle, 
+                                                 const CollisionMesh& hull)
+{
+    // The particle is treated as its center grown by its radius, so the 
+    // closest point of the hull to the center gives the penetration without 
+    // searching the Minkowski Sum of the particle with EPA
+    const D3DXVECTOR3& center = particle.GetPosition();
+    const float radius = particle.GetRadius();
+
+    auto getSupportPoint = [&](const D3DXVECTOR3& direction) -> D3DXVECTOR3
+    {
+        return (m_analyticSupport ? hull.GetSupportPoint(direction) :
+            FindFurthestPoint(hull.GetVertices(), direction)) - center;
+    };
+
+    // Search the hull relative to the center for the point closest to the origin
+    D3DXVECTOR3 points[4];
+    int count = 0;
+    D3DXVECTOR3 closestPoint = hull.GetPosition() - center;
+    const float tolerance = CORE_TOLERANCE * radius;
+
+    for(int iteration = 0; iteration < MAX_CORE_ITERATIONS; ++iteration)
+    {
+        // Centers on or inside the hull have no reliable direction to push along
+        const float distance = D3DXVec3Length(&closestPoint);
+        if(distance <= tolerance)
+        {
+            return false;
+        }
+
+        const D3DXVECTOR3 point = getSupportPoint(-closestPoint);
+        const float projection = D3DXVec3Dot(&closestPoint, &point);
+
+        // The hull is further than the radius in the direction searched
+        if(projection > radius * distance)
+        {
+            return true;
+        }
+
+        // No point of the hull is closer to the origin by more than the tolerance
+        if((distance * distance) - projection <= tolerance * distance)
+        {
+            if(distance < radius)
+            {
+                particle.ResolveCollision(closestPoint * ((distance - radius) / distance), 
+                    hull.GetVelocity(), hull.GetShape());
+            }
+            return true;
+        }
+
+        points[count++] = point;
+        closestPoint = ReduceSimplex(points, count);
+        if(count == 4)
         {
-            simplex.GenerateFaces();
-            const D3DXVECTOR3 penetration = GetConvexHullPenetration(particle, hull, simplex);
-            particle.ResolveCollision(penetration, hull.GetVelocity(), hull.GetShape());
+            return false;
         }
     }
+    return false;
 }
 
 bool CollisionSolver::AreConvexHullsColliding(const CollisionMesh& particle, 
@@ -65,12 +653,23 @@ bool CollisionSolver::AreConvexHullsColliding(const CollisionMesh& particle,
     // Penetration Depth Computation on 3D Game Objects' by Gino van den Bergen
     // http://graphics.stanford.edu/courses/cs468-01-fall/Papers/van-den-bergen.pdf
 
-    const std::vector<D3DXVECTOR3>& particleVertices = particle.GetVertices();
-    const std::vector<D3DXVECTOR3>& hullVertices = hull.GetVertices();
-
     // Determine an initial point for the simplex
-    const int initialIndex = 0;
-    D3DXVECTOR3 direction = particleVertices[initialIndex] - hullVertices[initialIndex];
+    D3DXVECTOR3 direction;
+    if(m_analyticSupport)
+    {
+        // The vertices may not have been moved yet this tick so start from the centers
+        direction = particle.GetPosition() - hull.GetPosition();
+        if(D3DXVec3LengthSq(&direction) == 0.0f)
+        {
+            direction = D3DXVECTOR3(1.0f, 0.0f, 0.0f);
+        }
+    }
+    else
+    {
+        const int initialIndex = 0;
+        direction = particle.GetVertices()[initialIndex] - hull.GetVertices()[initialIndex];
+    }
+
     D3DXVECTOR3 lastEdgePoint = GetMinkowskiSumEdgePoint(direction, particle, hull);
     simplex.AddPoint(lastEdgePoint);
         
@@ -181,6 +780,11 @@ D3DXVECTOR3 CollisionSolver::GetMinkowskiSumEdgePoint(const D3DXVECTOR3& directi
                                                          const CollisionMesh& particle, 
                                                          const CollisionMesh& hull)
 {
+    if(m_analyticSupport)
+    {
+        return particle.GetSupportPoint(direction) - hull.GetSupportPoint(-direction);
+    }
+
     return FindFurthestPoint(particle.GetVertices(), direction) - 
         FindFurthestPoint(hull.GetVertices(), -direction);
 }
@@ -247,7 +851,7 @@ bool CollisionSolver::SolveTetrahedronSimplex(Simplex& simplex, D3DXVECTOR3& dir
     {
         // Origin is outside of the CB plane
         // D is furthest point, remove it and search towards the origin
-        simplex.RemovePoint(pointD);
+        simplex.RemovePoint(2);
         direction = -CBnormal;
         originInsideSimplex = false;
     }
@@ -255,7 +859,7 @@ bool CollisionSolver::SolveTetrahedronSimplex(Simplex& simplex, D3DXVECTOR3& dir
     {
         // Origin is outside of the BD plane
         // C is furthest point, remove it and search towards the origin
-        simplex.RemovePoint(pointC);
+        simplex.RemovePoint(1);
         direction = -BDnormal;
         originInsideSimplex = false;
     }
@@ -263,7 +867,7 @@ bool CollisionSolver::SolveTetrahedronSimplex(Simplex& simplex, D3DXVECTOR3& dir
     {
         // Origin is outside of the DC plane
         // C is furthest point, remove it and search towards the origin
-        simplex.RemovePoint(pointB);
+        simplex.RemovePoint(0);
         direction = -DCnormal;
         originInsideSimplex = false;
     }
@@ -292,57 +896,260 @@ void CollisionSolver::SolveClothCollision(const D3DXVECTOR3& minBounds,
 {
     D3DPERF_BeginEvent(D3DCOLOR(), L"CollisionSolver::SolveClothCollision");
 
-    assert(!m_cloth.expired());
-    auto cloth = m_cloth.lock();
-    auto& particles = cloth->GetParticles();
+    std::vector<Cloth*> cloths;
+    for(const auto& cloth : m_cloths)
+    {
+        assert(!cloth.expired());
+        cloths.push_back(cloth.lock().get());
+    }
 
-    for(unsigned int i = 0; i < particles.size(); ++i)
+    SolveParticleCollisions(cloths);
+
+    for(Cloth* cloth : cloths)
     {
-        // Solve the particles against themselves
-        for(unsigned int j = i+1; j < particles.size(); ++j)
+        ParticleStore& particles = cloth->GetParticles();
+        const int count = particles.Size();
+        for(int i = 0; i < count; ++i)
         {
-            SolveParticleCollision(particles[i]->GetCollisionMesh(), 
-                particles[j]->GetCollisionMesh());
+            // Sleeping particles are already resting within the walls
+            if(!particles.HasFlag(i, ParticleStore::SLEEPING))
+            {
+                SolveWallCollision(particles, i, minBounds, maxBounds);
+            }
         }
+    }
+
+    D3DPERF_EndEvent();
+}
 
-        // Solve the particle against the eight scene walls
-        const D3DXVECTOR3& particlePosition = particles[i]->GetPosition();
-        D3DXVECTOR3 position(0.0, 0.0, 0.0);
+void CollisionSolver::SolveParticleCollisions(const std::vector<Cloth*>& cloths)
+{
+    const bool changed = GatherParticles(cloths);
+    const int count = static_cast<int>(m_broadphaseEntries.size());
+    if(count == 0)
+    {
+        return;
+    }
+
+    // Cached pairs stay valid until a particle may have 
+    // closed the skin between it and a particle not listed
+    bool rebuild = changed;
+    const float maxDistance = m_skin * 0.5f;
+    for(int i = 0; i < count && !rebuild; ++i)
+    {
+        const D3DXVECTOR3 movement = m_broadphasePositions[i] - m_listPositions[i];
+        rebuild = D3DXVec3LengthSq(&movement) > maxDistance * maxDistance;
+    }
+
+    if(rebuild)
+    {
+        BuildNeighbourLists(cloths);
+    }
+    ++m_listTicks;
 
-        // Check for ground and roof collisions
-        if(particlePosition.y <= maxBounds.y)
+    // Each thread solves the pairs it found so the 
+    // corrections are always applied in the same order
+    m_threads->ParallelFor(m_listChunks, [&](int begin, int end)
+    {
+        for(int chunk = begin; chunk < end; ++chunk)
         {
-            position.y = maxBounds.y-particlePosition.y;
+            FindParticleCollisions(cloths, chunk);
         }
-        else if(particlePosition.y >= minBounds.y)
+    });
+
+    for(int chunk = 0; chunk < m_listChunks; ++chunk)
+    {
+        for(const Correction& correction : m_corrections[chunk])
         {
-            position.y = minBounds.y-particlePosition.y;
+            const auto& entry = m_broadphaseEntries[correction.entry];
+            cloths[entry.first]->GetParticles().GetCollisionMesh(
+                entry.second).ResolveCollision(correction.translation);
         }
+    }
+
+    if(m_engine->diagnostic()->AllowDiagnostics(Diagnostic::COLLISION))
+    {
+        m_engine->diagnostic()->UpdateText(Diagnostic::COLLISION, "NeighbourListRebuilds",
+            Diagnostic::WHITE, StringCast(m_listBuilds) + "/" + StringCast(m_listTicks));
+
+        m_engine->diagnostic()->UpdateText(Diagnostic::COLLISION, "NeighbourListLength",
+            Diagnostic::WHITE, StringCast(m_listLength));
 
-        // Check for left and right wall collisions
-        if(particlePosition.x >= maxBounds.x)
+        std::string hullPath = m_analyticSupport ? "shape" : "vertices";
+        hullPath += m_coreShapes ? ", core" : "";
+        hullPath += m_closedFormHulls ? ", closed form" : "";
+
+        m_engine->diagnostic()->UpdateText(Diagnostic::COLLISION, "HullPairNs",
+            Diagnostic::WHITE, StringCast(m_hullTimer->GetAverageTime()) + " (" + hullPath + ")");
+    }
+}
+
+bool CollisionSolver::GatherParticles(const std::vector<Cloth*>& cloths)
+{
+    bool changed = cloths.size() != m_clothRadius.size();
+    m_broadphasePositions.clear();
+    m_broadphaseEntries.clear();
+    m_clothRadius.resize(cloths.size());
+
+    for(unsigned int cloth = 0; cloth < cloths.size(); ++cloth)
+    {
+        ParticleStore& particles = cloths[cloth]->GetParticles();
+        const int count = particles.Size();
+        for(int i = 0; i < count; ++i)
         {
-            position.x = maxBounds.x-particlePosition.x;
+            m_broadphasePositions.push_back(particles.GetPosition(i));
+            m_broadphaseEntries.push_back(std::make_pair(cloth, i));
         }
-        else if(particlePosition.x <= minBounds.x)
+
+        // All particles of a cloth share the same collision radius
+        const float radius = count > 0 ? particles.GetCollisionMesh(0).GetRadius() : 0.0f;
+        changed |= radius != m_clothRadius[cloth];
+        m_clothRadius[cloth] = radius;
+    }
+
+    // Any change in the particles means the lists refer to the wrong entries
+    changed |= cloths != m_listCloths || m_broadphaseEntries != m_listEntries;
+    return changed;
+}
+
+void CollisionSolver::BuildNeighbourLists(const std::vector<Cloth*>& cloths)
+{
+    const int count = static_cast<int>(m_broadphaseEntries.size());
+    const float radius = *std::max_element(m_clothRadius.begin(), m_clothRadius.end());
+
+    m_listCloths = cloths;
+    m_listEntries = m_broadphaseEntries;
+    m_listPositions = m_broadphasePositions;
+    m_skin = radius * SKIN_SCALE;
+
+    // Particles within the skin of each other are never more than a cell apart
+    m_broadphase->Build(m_broadphasePositions, (radius * 2.0f) + m_skin);
+
+    m_listChunks = max(1, min(m_threads->GetThreadCount(), 
+        count / MIN_PARTICLES_PER_THREAD));
+
+    m_threads->ParallelFor(m_listChunks, [&](int begin, int end)
+    {
+        for(int chunk = begin; chunk < end; ++chunk)
+        {
+            FindNeighbourPairs(cloths, (chunk * count) / m_listChunks,
+                ((chunk + 1) * count) / m_listChunks, chunk);
+        }
+    });
+
+    int pairs = 0;
+    for(int chunk = 0; chunk < m_listChunks; ++chunk)
+    {
+        pairs += static_cast<int>(m_neighbourPairs[chunk].size());
+    }
+
+    ++m_listBuilds;
+    m_listLength = static_cast<float>(pairs) / count;
+}
+
+void CollisionSolver::FindNeighbourPairs(const std::vector<Cloth*>& cloths,
+                                         int begin, 
+                                         int end, 
+                                         int chunk)
+{
+    std::vector<int>& neighbours = m_neighbours[chunk];
+    std::vector<std::pair<int, int>>& pairs = m_neighbourPairs[chunk];
+    pairs.clear();
+
+    for(int i = begin; i < end; ++i)
+    {
+        const int clothA = m_broadphaseEntries[i].first;
+        const int particleA = m_broadphaseEntries[i].second;
+
+        m_broadphase->FindNeighbours(m_broadphasePositions[i], neighbours);
+        for(int j : neighbours)
         {
-            position.x = minBounds.x-particlePosition.x;
+            // Particles joined by a spring are held apart by the spring instead
+            const int clothB = m_broadphaseEntries[j].first;
+            const int particleB = m_broadphaseEntries[j].second;
+            if(j <= i || (clothA == clothB && 
+                cloths[clothA]->IsCollisionMasked(particleA, particleB)))
+            {
+                continue;
+            }
+
+            const float distance = m_clothRadius[clothA] + m_clothRadius[clothB] + m_skin;
+            const D3DXVECTOR3 particleToParticle = m_broadphasePositions[j] - m_broadphasePositions[i];
+            if(D3DXVec3LengthSq(&particleToParticle) < distance * distance)
+            {
+                pairs.push_back(std::make_pair(i, j));
+            }
         }
+    }
+}
 
-        // Check for forward and backward wall collisions
-        if(particlePosition.z >= maxBounds.z)
+void CollisionSolver::FindParticleCollisions(const std::vector<Cloth*>& cloths, int chunk)
+{
+    std::vector<Correction>& corrections = m_corrections[chunk];
+    corrections.clear();
+
+    D3DXVECTOR3 translation;
+    for(const auto& pair : m_neighbourPairs[chunk])
+    {
+        // Skip pairs that are both resting
+        const auto& entryA = m_broadphaseEntries[pair.first];
+        const auto& entryB = m_broadphaseEntries[pair.second];
+        if(cloths[entryA.first]->GetParticles().HasFlag(entryA.second, ParticleStore::SLEEPING) &&
+           cloths[entryB.first]->GetParticles().HasFlag(entryB.second, ParticleStore::SLEEPING))
         {
-            position.z = maxBounds.z-particlePosition.z;
+            continue;
         }
-        else if(particlePosition.z <= minBounds.z)
+
+        if(GetParticleCollision(m_broadphasePositions[pair.first], 
+            m_broadphasePositions[pair.second], m_clothRadius[entryA.first] + 
+            m_clothRadius[entryB.first], translation))
         {
-            position.z = minBounds.z-particlePosition.z;
+            corrections.push_back(Correction(pair.first, -translation));
+            corrections.push_back(Correction(pair.second, translation));
         }
+    }
+}
+
+void CollisionSolver::SolveWallCollision(ParticleStore& particles,
+                                         int index,
+                                         const D3DXVECTOR3& minBounds, 
+                                         const D3DXVECTOR3& maxBounds)
+{
+    // Solve the particle against the eight scene walls
+    const D3DXVECTOR3& particlePosition = particles.GetPosition(index);
+    D3DXVECTOR3 position(0.0, 0.0, 0.0);
 
-        particles[i]->MovePosition(position);
+    // Check for ground and roof collisions
+    if(particlePosition.y <= maxBounds.y)
+    {
+        position.y = maxBounds.y-particlePosition.y;
+    }
+    else if(particlePosition.y >= minBounds.y)
+    {
+        position.y = minBounds.y-particlePosition.y;
     }
 
-    D3DPERF_EndEvent();
+    // Check for left and right wall collisions
+    if(particlePosition.x >= maxBounds.x)
+    {
+        position.x = maxBounds.x-particlePosition.x;
+    }
+    else if(particlePosition.x <= minBounds.x)
+    {
+        position.x = minBounds.x-particlePosition.x;
+    }
+
+    // Check for forward and backward wall collisions
+    if(particlePosition.z >= maxBounds.z)
+    {
+        position.z = maxBounds.z-particlePosition.z;
+    }
+    else if(particlePosition.z <= minBounds.z)
+    {
+        position.z = minBounds.z-particlePosition.z;
+    }
+
+    particles.MovePosition(index, position);
 }
 
 void CollisionSolver::SolveObjectCollision(CollisionMesh& particle,
@@ -350,6 +1157,11 @@ void CollisionSolver::SolveObjectCollision(CollisionMesh& particle,
 {
     if(particle.IsDynamic())
     {
+        if(m_continuousCollision)
+        {
+            SolveSweptCollision(particle, object);
+        }
+
         if(object.GetShape() == Geometry::SPHERE)
         {
             SolveParticleSphereCollision(particle, object);
@@ -361,6 +1173,71 @@ void CollisionSolver::SolveObjectCollision(CollisionMesh& particle,
     }
 }
 
+void CollisionSolver::SolveSweptCollision(CollisionMesh& particle, 
+                                          const CollisionMesh& object)
+{
+    // Sweep relative to the object from where both were at the start of the tick
+    const D3DXVECTOR3& end = particle.GetPosition();
+    const D3DXVECTOR3 objectMovement = object.GetTickMovement();
+    const D3DXVECTOR3 start = end - particle.GetTickMovement() + objectMovement;
+    const D3DXVECTOR3 movement = end - start;
+
+    // Particles moving less than their radius can't pass through without overlapping
+    const float radius = particle.GetRadius();
+    if(D3DXVec3LengthSq(&movement) <= radius * radius)
+    {
+        return;
+    }
+
+    float time = 0.0f;
+    bool impact = false;
+    switch(object.GetShape())
+    {
+    case Geometry::SPHERE:
+        impact = GetSphereTimeOfImpact(start, movement, 
+            object.GetPosition(), object.GetRadius() + radius, time);
+        break;
+    case Geometry::BOX:
+        impact = GetBoxTimeOfImpact(start, movement, 
+            object.CollisionMatrix(), radius, time);
+        break;
+    case Geometry::CYLINDER:
+        impact = GetCylinderTimeOfImpact(start, movement, 
+            object.CollisionMatrix(), radius, time);
+        break;
+    }
+
+    if(impact)
+    {
+        const D3DXVECTOR3 impactPosition = start + (movement * time);
+        particle.ResolveCollision(impactPosition - end, 
+            objectMovement, object.GetShape());
+    }
+}
+
+void CollisionSolver::ToggleContinuousCollision()
+{
+    m_continuousCollision = !m_continuousCollision;
+}
+
+void CollisionSolver::ToggleAnalyticSupport()
+{
+    m_analyticSupport = !m_analyticSupport;
+    m_hullTimer->Reset();
+}
+
+void CollisionSolver::ToggleCoreShapes()
+{
+    m_coreShapes = !m_coreShapes;
+    m_hullTimer->Reset();
+}
+
+void CollisionSolver::ToggleClosedFormHulls()
+{
+    m_closedFormHulls = !m_closedFormHulls;
+    m_hullTimer->Reset();
+}
+
 void CollisionSolver::UpdateDiagnostics(const Simplex& simplex, 
                                         const D3DXVECTOR3& furthestPoint)
 {
@@ -376,22 +1253,21 @@ void CollisionSolver::UpdateDiagnostics(const Simplex& simplex,
         m_engine->diagnostic()->UpdateSphere(Diagnostic::COLLISION, 
             "FurthestPoint", Diagnostic::MAGENTA, furthestPoint, radius);
 
-        const auto& borders = simplex.GetBorderEdges();
-        for(unsigned int i = 0; i < borders.size(); ++i)
+        for(int i = 0; i < simplex.GetBorderEdgeCount(); ++i)
         {
+            const Edge& edge = simplex.GetBorderEdge(i);
             m_engine->diagnostic()->UpdateLine(Diagnostic::COLLISION,
                 "BorderEdge" + StringCast(i), Diagnostic::RED, 
-                simplex.GetPoint(borders[i].indices[0]), 
-                simplex.GetPoint(borders[i].indices[1]));                    
+                simplex.GetPoint(edge.indices[0]), 
+                simplex.GetPoint(edge.indices[1]));                    
         }
 
-        const auto& faces = simplex.GetFaces();
-        for(unsigned int i = 0; i < faces.size(); ++i)
+        for(int i = 0; i < simplex.GetFaceCount(); ++i)
         {
-            if(faces[i].alive)
+            const Face& face = simplex.GetFace(i);
+            if(face.alive)
             {
                 std::string id = StringCast(i);
-                const Face& face = faces[i];
 
                 const D3DXVECTOR3 center = simplex.GetFaceCenter(i);
                 const D3DXVECTOR3& normal = face.normal * normalLength;
@@ -9,6 +9,10 @@
 struct Face;
 class Simplex;
 class Particle;
+class ParticleStore;
+class SpatialHash;
+class ThreadPool;
+class Stopwatch;
 class Cloth;
 
 /**
@@ -21,15 +25,20 @@ public:
     /**
     * Constructor
     * @param engine Callbacks from the rendering engine
-    * @param cloth The cloth to solve collisions for
     */
-    CollisionSolver(std::shared_ptr<Engine> engine, std::shared_ptr<Cloth> cloth);
+    explicit CollisionSolver(std::shared_ptr<Engine> engine);
 
     /**
     * Destructor
     */
     ~CollisionSolver();
 
+    /**
+    * Sets the cloths in the scene to solve collisions for
+    * @param cloths The cloths in the scene
+    */
+    void SetCloths(const std::vector<std::shared_ptr<Cloth>>& cloths);
+
     /**
     * Detects and solves cloth particle-particle and particle-wall collisions
     * @param minBounds The minimum point inside the walls
@@ -44,6 +53,30 @@ public:
     */
     void SolveObjectCollision(CollisionMesh& particle, const CollisionMesh& object);
 
+    /**
+    * Toggles whether particles are swept against the scene objects
+    * to stop fast moving particles or objects passing through each other
+    */
+    void ToggleContinuousCollision();
+
+    /**
+    * Toggles whether the convex hull collisions search the shape of each
+    * scene object directly or search the vertices of its geometry
+    */
+    void ToggleAnalyticSupport();
+
+    /**
+    * Toggles whether particles collide with the convex hulls as their center
+    * grown by their radius or as the full sphere whenever the center is outside
+    */
+    void ToggleCoreShapes();
+
+    /**
+    * Toggles whether particles collide with boxes and cylinders
+    * directly from their shape or through the convex hull search
+    */
+    void ToggleClosedFormHulls();
+
 private:
 
     /**
@@ -53,11 +86,90 @@ private:
     CollisionSolver& operator=(const CollisionSolver&) = delete;
 
     /**
-    * Detects and solves a collision between two particles
-    * @param particleA The collision mesh for the first particle
-    * @param particleB The collision mesh for the second particle
+    * Correction found for a particle by a thread
+    */
+    struct Correction
+    {
+        Correction(int entry, const D3DXVECTOR3& translation)
+            : entry(entry), translation(translation) {}
+
+        int entry;               ///< Broadphase entry of the particle to move
+        D3DXVECTOR3 translation; ///< Amount to move the particle
+    };
+
+    /**
+    * Detects a collision between two particles
+    * @param positionA/positionB The positions of the two particles
+    * @param combinedRadius The radius of both particles added together
+    * @param translation Filled with the amount to move the second particle 
+    *        away from the first, with the first moving the opposite way
+    * @return whether the particles are colliding
+    */
+    bool GetParticleCollision(const D3DXVECTOR3& positionA,
+                              const D3DXVECTOR3& positionB,
+                              float combinedRadius,
+                              D3DXVECTOR3& translation) const;
+
+    /**
+    * Detects and solves collisions between the particles of all cloths. Pairs of
+    * particles within a skin distance are cached and only searched for again
+    * through the spatial hash once a particle has moved over half the skin.
+    * @param cloths The cloths in the scene
+    */
+    void SolveParticleCollisions(const std::vector<Cloth*>& cloths);
+
+    /**
+    * Gathers the positions of the particles of all cloths
+    * @param cloths The cloths in the scene
+    * @return whether the particles differ from when the pairs were cached
+    */
+    bool GatherParticles(const std::vector<Cloth*>& cloths);
+
+    /**
+    * Caches the pairs of particles within the skin distance of each other
+    * @param cloths The cloths in the scene
+    */
+    void BuildNeighbourLists(const std::vector<Cloth*>& cloths);
+
+    /**
+    * Finds the pairs within the skin distance for a range of the broadphase entries
+    * @param cloths The cloths in the scene
+    * @param begin/end The range of broadphase entries to search
+    * @param chunk The index of the range, used for the thread's buffers
+    * @note only reads the particles so ranges can be searched in parallel
+    */
+    void FindNeighbourPairs(const std::vector<Cloth*>& cloths,
+                            int begin, 
+                            int end, 
+                            int chunk);
+
+    /**
+    * Finds the collisions between the cached pairs of a range
+    * @param cloths The cloths in the scene
+    * @param chunk The index of the range, used for the thread's buffers
+    * @note only reads the particles so ranges can be solved in parallel
     */
-    void SolveParticleCollision(CollisionMesh& particleA, CollisionMesh& particleB);
+    void FindParticleCollisions(const std::vector<Cloth*>& cloths, int chunk);
+
+    /**
+    * Detects and solves a collision between a particle and the scene walls
+    * @param particles The particles of the cloth
+    * @param index The index of the particle to solve
+    * @param minBounds The minimum point inside the walls
+    * @param maxBounds The maximum point inside the walls
+    */
+    void SolveWallCollision(ParticleStore& particles,
+                            int index,
+                            const D3DXVECTOR3& minBounds, 
+                            const D3DXVECTOR3& maxBounds);
+
+    /**
+    * Sweeps a particle from where it started the tick to its current position,
+    * relative to a scene object, and moves it back to where it first touches the object
+    * @param particle The collision mesh for the particle
+    * @param object The collision mesh for the scene object
+    */
+    void SolveSweptCollision(CollisionMesh& particle, const CollisionMesh& object);
 
     /**
     * Detects and solves a collision between a convex hull and a particle
@@ -66,6 +178,24 @@ private:
     */
     void SolveParticleHullCollision(CollisionMesh& particle, const CollisionMesh& hull);
 
+    /**
+    * Detects and solves a collision between a box or cylinder and a 
+    * particle from the closest point of the shape to the particle center
+    * @param particle The collision mesh for the particle
+    * @param hull The collision mesh for the convex hull
+    * @return whether the collision was solved, which requires the hull be a box or cylinder
+    */
+    bool SolveParticleShapeCollision(CollisionMesh& particle, const CollisionMesh& hull);
+
+    /**
+    * Detects and solves a collision between a convex hull and the 
+    * center of a particle grown by its radius from the closest hull point
+    * @param particle The collision mesh for the particle
+    * @param hull The collision mesh for the convex hull
+    * @return whether the collision was solved, which requires the center be outside the hull
+    */
+    bool SolveParticleCoreCollision(CollisionMesh& particle, const CollisionMesh& hull);
+
     /**
     * Detects and solves a collision between a sphere and particle
     * @param particle The collision mesh for the particle
@@ -84,7 +214,7 @@ private:
 
     /**
     * Generates a point on the edge of the Minkowski Sum hull
-    * using a chosen vertex from each collision mesh that is furthest
+    * using a chosen point from each collision mesh that is furthest
     * along the given direction. Known as a 'support' function.
     * @param direction The direction to search along
     * @param particle The collision mesh for the particle
@@ -148,6 +278,28 @@ private:
 
 private:
 
-    std::weak_ptr<Cloth> m_cloth;     ///< Cloth object holding all particles
-    std::shared_ptr<Engine> m_engine; ///< Callbacks for the rendering engine
+    std::vector<std::weak_ptr<Cloth>> m_cloths;                     ///< Cloth objects holding all particles
+    std::shared_ptr<Engine> m_engine;                               ///< Callbacks for the rendering engine
+    std::unique_ptr<SpatialHash> m_broadphase;                      ///< Finds nearby particles of all cloths
+    std::unique_ptr<ThreadPool> m_threads;                          ///< Threads for finding particle collisions
+    std::unique_ptr<Stopwatch> m_hullTimer;                         ///< Profiling for each particle-hull collision
+    std::unique_ptr<Simplex> m_simplex;                             ///< Simplex reused by each particle-hull search
+    std::vector<D3DXVECTOR3> m_broadphasePositions;                 ///< Positions of all particles in the broadphase
+    std::vector<std::pair<int, int>> m_broadphaseEntries;           ///< Cloth and particle index of each broadphase entry
+    std::vector<float> m_clothRadius;                               ///< Collision radius of the particles of each cloth
+    std::vector<std::vector<int>> m_neighbours;                     ///< Nearby broadphase entries found by each thread
+    std::vector<std::vector<Correction>> m_corrections;             ///< Particle corrections found by each thread
+    std::vector<std::vector<std::pair<int, int>>> m_neighbourPairs; ///< Cached pairs of entries found by each thread
+    std::vector<Cloth*> m_listCloths;                               ///< Cloths when the pairs were cached
+    std::vector<std::pair<int, int>> m_listEntries;                 ///< Broadphase entries when the pairs were cached
+    std::vector<D3DXVECTOR3> m_listPositions;                       ///< Particle positions when the pairs were cached
+    float m_skin = 0.0f;                                            ///< Distance past colliding that pairs are cached within
+    int m_listChunks = 0;                                           ///< Number of ranges the pairs were cached in
+    int m_listBuilds = 0;                                           ///< Number of times the pairs have been cached
+    int m_listTicks = 0;                                            ///< Number of ticks the pairs have been solved
+    float m_listLength = 0.0f;                                      ///< Average cached pairs for each particle
+    bool m_continuousCollision = true;                              ///< Whether particles are swept against scene objects
+    bool m_analyticSupport = true;                                  ///< Whether hulls are searched from their shape or vertices
+    bool m_coreShapes = true;                                       ///< Whether particles are solved from their center and radius
+    bool m_closedFormHulls = true;                                  ///< Whether boxes and cylinders are solved from their shape
 };
\ No newline at end of file
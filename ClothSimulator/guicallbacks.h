@@ -38,10 +38,12 @@ struct GuiCallbacks
     SetValue setIterations; ///< Function set iterations
     SetValue setVertexRows; ///< Function set vertex number
     SetValue setSpacing; ///< Function set spacing between vertices
+    SetValue setSolver; ///< Function set cloth solver
     GetValue getTimestep; ///< Function get timestep
     GetValue getIterations; ///< Function get iterations
     GetValue getVertexRows; ///< Function get vertex number
     GetValue getSpacing; ///< Function get spacing between vertices
+    GetValue getSolver; ///< Function get cloth solver
 };
 
 /**
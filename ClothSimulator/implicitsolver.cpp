@@ -0,0 +1,323 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - implicitsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "implicitsolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <xmmintrin.h>
+
+namespace
+{
+    const float STRETCH_STIFFNESS = 100.0f;  ///< Initial spring constant for stretch springs
+    const float SHEAR_STIFFNESS = 20.0f;     ///< Initial spring constant for shear springs
+    const float BEND_STIFFNESS = 2.0f;       ///< Initial spring constant for bending springs
+    const int MAX_CG_ITERATIONS = 20;        ///< Maximum conjugate gradient iterations per tick
+    const float CG_TOLERANCE = 1.0e-2f;      ///< Residual relative to the initial residual to stop at
+    const int SIMD_WIDTH = 4;                ///< Springs multiplied together with SSE
+
+    /**
+    * @return the dot product of two vectors of particle values
+    */
+    float Dot(const std::vector<D3DXVECTOR3>& a, const std::vector<D3DXVECTOR3>& b)
+    {
+        double sum = 0.0;
+        for(unsigned int i = 0; i < a.size(); ++i)
+        {
+            sum += D3DXVec3Dot(&a[i], &b[i]);
+        }
+        return static_cast<float>(sum);
+    }
+
+    /**
+    * @return the component-wise product of two vectors
+    */
+    D3DXVECTOR3 Multiply(const D3DXVECTOR3& a, const D3DXVECTOR3& b)
+    {
+        return D3DXVECTOR3(a.x * b.x, a.y * b.y, a.z * b.z);
+    }
+}
+
+ImplicitSolver::ImplicitSolver()
+{
+    m_stiffness[SpringStore::STRETCH] = STRETCH_STIFFNESS;
+    m_stiffness[SpringStore::SHEAR] = SHEAR_STIFFNESS;
+    m_stiffness[SpringStore::BEND] = BEND_STIFFNESS;
+}
+
+void ImplicitSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    const int count = particles.Size();
+    m_stride = springs.Size() + SIMD_WIDTH;
+    m_jacobian.assign(m_stride * MAX_COMPONENTS, 0.0f);
+    m_fixed.resize(count);
+    m_velocity.resize(count);
+    m_force.resize(count);
+    m_deltaVelocity.resize(count);
+    m_residual.resize(count);
+    m_direction.resize(count);
+    m_product.resize(count);
+    m_preconditioned.resize(count);
+    m_inverseDiagonal.resize(count);
+}
+
+void ImplicitSolver::Solve(ParticleStore& particles,
+                           const SpringStore& springs,
+                           ThreadPool& threads,
+                           const SolverSettings& settings)
+{
+    if(static_cast<int>(m_velocity.size()) != particles.Size() ||
+        m_stride != springs.Size() + SIMD_WIDTH)
+    {
+        Initialise(particles, springs);
+    }
+
+    const int count = particles.Size();
+    const float timestep = settings.timestep;
+    const float timestepSqr = settings.timestepSquared;
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+    std::vector<D3DXVECTOR3>& previous = particles.GetPreviousPositions();
+    const std::vector<D3DXVECTOR3>& acceleration = particles.GetAccelerations();
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+
+    // Velocity is implied by the verlet positions to allow switching solvers
+    for(int i = 0; i < count; ++i)
+    {
+        m_fixed[i] = (flags[i] & (ParticleStore::PINNED|
+            ParticleStore::COLLIDING|ParticleStore::SLEEPING)) != 0;
+        m_velocity[i] = (positions[i] - previous[i]) * (settings.damping / timestep);
+    }
+    Filter(m_velocity);
+
+    CalculateForces(particles, springs);
+
+    // Solve (I + h^2K)dv = h(f + a) - h^2Kv for the change in velocity
+    MultiplyStiffness(springs, threads, m_velocity, m_product);
+    for(int i = 0; i < count; ++i)
+    {
+        m_residual[i] = ((m_force[i] + acceleration[i]) * timestep) - (m_product[i] * timestepSqr);
+        m_inverseDiagonal[i].x = 1.0f / (1.0f + (timestepSqr * m_inverseDiagonal[i].x));
+        m_inverseDiagonal[i].y = 1.0f / (1.0f + (timestepSqr * m_inverseDiagonal[i].y));
+        m_inverseDiagonal[i].z = 1.0f / (1.0f + (timestepSqr * m_inverseDiagonal[i].z));
+        MakeZeroVector(m_deltaVelocity[i]);
+    }
+    Filter(m_residual);
+
+    for(int i = 0; i < count; ++i)
+    {
+        m_preconditioned[i] = Multiply(m_residual[i], m_inverseDiagonal[i]);
+    }
+    m_direction = m_preconditioned;
+
+    float residualDot = Dot(m_residual, m_preconditioned);
+    const float tolerance = Dot(m_residual, m_residual) * CG_TOLERANCE * CG_TOLERANCE;
+
+    m_lastIterations = 0;
+    while(m_lastIterations < MAX_CG_ITERATIONS && residualDot > 0.0f)
+    {
+        ++m_lastIterations;
+        MultiplySystem(springs, threads, timestepSqr, m_direction, m_product);
+        Filter(m_product);
+
+        const float alpha = residualDot / Dot(m_direction, m_product);
+        for(int i = 0; i < count; ++i)
+        {
+            m_deltaVelocity[i] += m_direction[i] * alpha;
+            m_residual[i] -= m_product[i] * alpha;
+        }
+
+        if(Dot(m_residual, m_residual) <= tolerance)
+        {
+            break;
+        }
+
+        for(int i = 0; i < count; ++i)
+        {
+            m_preconditioned[i] = Multiply(m_residual[i], m_inverseDiagonal[i]);
+        }
+
+        const float newResidualDot = Dot(m_residual, m_preconditioned);
+        const float beta = newResidualDot / residualDot;
+        residualDot = newResidualDot;
+
+        for(int i = 0; i < count; ++i)
+        {
+            m_direction[i] = m_preconditioned[i] + (m_direction[i] * beta);
+        }
+    }
+
+    for(int i = 0; i < count; ++i)
+    {
+        previous[i] = positions[i];
+        if(!m_fixed[i])
+        {
+            positions[i] += (m_velocity[i] + m_deltaVelocity[i]) * timestep;
+        }
+    }
+}
+
+void ImplicitSolver::CalculateForces(const ParticleStore& particles, const SpringStore& springs)
+{
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const std::vector<float>& restLength = springs.GetRestLengths();
+    const std::vector<unsigned char>& types = springs.GetTypes();
+    const std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+
+    const D3DXVECTOR3 zero(0.0f, 0.0f, 0.0f);
+    std::fill(m_force.begin(), m_force.end(), zero);
+    std::fill(m_inverseDiagonal.begin(), m_inverseDiagonal.end(), zero);
+
+    float* jacobian[MAX_COMPONENTS];
+    for(int c = 0; c < MAX_COMPONENTS; ++c)
+    {
+        jacobian[c] = &m_jacobian[c * m_stride];
+    }
+
+    for(int i = 0; i < springs.Size(); ++i)
+    {
+        const std::uint32_t p1 = indices[i*2];
+        const std::uint32_t p2 = indices[i*2+1];
+        const float stiffness = m_stiffness[types[i]];
+
+        D3DXVECTOR3 difference(positions[p2] - positions[p1]);
+        const float length = D3DXVec3Length(&difference);
+        const D3DXVECTOR3 direction(length > 0.0f ? difference / length : zero);
+
+        const D3DXVECTOR3 force(direction * (stiffness * (length - restLength[i])));
+        m_force[p1] += force;
+        m_force[p2] -= force;
+
+        // Drop the compressive part of the tangent stiffness to keep the system positive definite
+        const float tangent = length > 0.0f ? stiffness * max(1.0f - (restLength[i] / length), 0.0f) : 0.0f;
+        const float normal = stiffness - tangent;
+
+        jacobian[XX][i] = (normal * direction.x * direction.x) + tangent;
+        jacobian[XY][i] = normal * direction.x * direction.y;
+        jacobian[XZ][i] = normal * direction.x * direction.z;
+        jacobian[YY][i] = (normal * direction.y * direction.y) + tangent;
+        jacobian[YZ][i] = normal * direction.y * direction.z;
+        jacobian[ZZ][i] = (normal * direction.z * direction.z) + tangent;
+
+        // Diagonal is accumulated here and inverted once the timestep is applied
+        const D3DXVECTOR3 diagonal(jacobian[XX][i], jacobian[YY][i], jacobian[ZZ][i]);
+        m_inverseDiagonal[p1] += diagonal;
+        m_inverseDiagonal[p2] += diagonal;
+    }
+}
+
+void ImplicitSolver::MultiplyStiffness(const SpringStore& springs,
+                                       ThreadPool& threads,
+                                       const std::vector<D3DXVECTOR3>& input,
+                                       std::vector<D3DXVECTOR3>& output) const
+{
+    std::fill(output.begin(), output.end(), D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+
+    // Springs in a batch share no particles and can scatter without conflicts
+    for(int i = 0; i < SpringStore::MAX_BATCHES; ++i)
+    {
+        const int begin = springs.GetBatchBegin(i);
+        threads.ParallelFor(springs.GetBatchEnd(i) - begin, [&](int start, int end)
+        {
+            MultiplyBatch(springs, begin + start, begin + end, input, output);
+        });
+    }
+}
+
+void ImplicitSolver::MultiplyBatch(const SpringStore& springs,
+                                   int begin, int end,
+                                   const std::vector<D3DXVECTOR3>& input,
+                                   std::vector<D3DXVECTOR3>& output) const
+{
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const float* jacobian = &m_jacobian[0];
+    const int blockEnd = end - ((end - begin) % SIMD_WIDTH);
+
+    // Four springs are gathered into registers holding one component each
+    for(int i = begin; i < blockEnd; i += SIMD_WIDTH)
+    {
+        const std::uint32_t* p = &indices[i*2];
+        const D3DXVECTOR3& a0 = input[p[0]];
+        const D3DXVECTOR3& a1 = input[p[2]];
+        const D3DXVECTOR3& a2 = input[p[4]];
+        const D3DXVECTOR3& a3 = input[p[6]];
+        const D3DXVECTOR3& b0 = input[p[1]];
+        const D3DXVECTOR3& b1 = input[p[3]];
+        const D3DXVECTOR3& b2 = input[p[5]];
+        const D3DXVECTOR3& b3 = input[p[7]];
+
+        const __m128 dx = _mm_sub_ps(_mm_setr_ps(a0.x, a1.x, a2.x, a3.x), _mm_setr_ps(b0.x, b1.x, b2.x, b3.x));
+        const __m128 dy = _mm_sub_ps(_mm_setr_ps(a0.y, a1.y, a2.y, a3.y), _mm_setr_ps(b0.y, b1.y, b2.y, b3.y));
+        const __m128 dz = _mm_sub_ps(_mm_setr_ps(a0.z, a1.z, a2.z, a3.z), _mm_setr_ps(b0.z, b1.z, b2.z, b3.z));
+
+        const __m128 xx = _mm_loadu_ps(jacobian + (XX * m_stride) + i);
+        const __m128 xy = _mm_loadu_ps(jacobian + (XY * m_stride) + i);
+        const __m128 xz = _mm_loadu_ps(jacobian + (XZ * m_stride) + i);
+        const __m128 yy = _mm_loadu_ps(jacobian + (YY * m_stride) + i);
+        const __m128 yz = _mm_loadu_ps(jacobian + (YZ * m_stride) + i);
+        const __m128 zz = _mm_loadu_ps(jacobian + (ZZ * m_stride) + i);
+
+        float x[SIMD_WIDTH], y[SIMD_WIDTH], z[SIMD_WIDTH];
+        _mm_storeu_ps(x, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, dx), _mm_mul_ps(xy, dy)), _mm_mul_ps(xz, dz)));
+        _mm_storeu_ps(y, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xy, dx), _mm_mul_ps(yy, dy)), _mm_mul_ps(yz, dz)));
+        _mm_storeu_ps(z, _mm_add_ps(_mm_add_ps(_mm_mul_ps(xz, dx), _mm_mul_ps(yz, dy)), _mm_mul_ps(zz, dz)));
+
+        for(int j = 0; j < SIMD_WIDTH; ++j)
+        {
+            const D3DXVECTOR3 product(x[j], y[j], z[j]);
+            output[p[j*2]] += product;
+            output[p[j*2+1]] -= product;
+        }
+    }
+
+    for(int i = blockEnd; i < end; ++i)
+    {
+        const std::uint32_t p1 = indices[i*2];
+        const std::uint32_t p2 = indices[i*2+1];
+        const D3DXVECTOR3 d(input[p1] - input[p2]);
+
+        const D3DXVECTOR3 product(
+            (jacobian[(XX * m_stride) + i] * d.x) + (jacobian[(XY * m_stride) + i] * d.y) + (jacobian[(XZ * m_stride) + i] * d.z),
+            (jacobian[(XY * m_stride) + i] * d.x) + (jacobian[(YY * m_stride) + i] * d.y) + (jacobian[(YZ * m_stride) + i] * d.z),
+            (jacobian[(XZ * m_stride) + i] * d.x) + (jacobian[(YZ * m_stride) + i] * d.y) + (jacobian[(ZZ * m_stride) + i] * d.z));
+
+        output[p1] += product;
+        output[p2] -= product;
+    }
+}
+
+void ImplicitSolver::MultiplySystem(const SpringStore& springs,
+                                    ThreadPool& threads,
+                                    float timestepSqr,
+                                    const std::vector<D3DXVECTOR3>& input,
+                                    std::vector<D3DXVECTOR3>& output) const
+{
+    MultiplyStiffness(springs, threads, input, output);
+    for(unsigned int i = 0; i < output.size(); ++i)
+    {
+        output[i] = input[i] + (output[i] * timestepSqr);
+    }
+}
+
+void ImplicitSolver::Filter(std::vector<D3DXVECTOR3>& values) const
+{
+    for(unsigned int i = 0; i < values.size(); ++i)
+    {
+        if(m_fixed[i])
+        {
+            MakeZeroVector(values[i]);
+        }
+    }
+}
+
+void ImplicitSolver::SetStiffness(SpringStore::Type type, float stiffness)
+{
+    m_stiffness[type] = max(stiffness, 0.0f);
+}
+
+float ImplicitSolver::GetStiffness(SpringStore::Type type) const
+{
+    return m_stiffness[type];
+}
@@ -0,0 +1,145 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - implicitsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springstore.h"
+#include "directx.h"
+
+#include <vector>
+
+/**
+* Implicit backward euler solver treating the springs as stiff forces
+* The linear system for the change in velocity is solved with a jacobi
+* preconditioned conjugate gradient without ever building the matrix,
+* allowing large timesteps without the cloth becoming unstable
+*/
+class ImplicitSolver : public ISolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    ImplicitSolver();
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "Implicit"; }
+
+    /**
+    * Sets the stiffness for a type of spring
+    * @param type The type of spring to set
+    * @param stiffness The spring constant for the type
+    */
+    void SetStiffness(SpringStore::Type type, float stiffness);
+
+    /**
+    * @param type The type of spring to query
+    * @return the spring constant for the type of spring
+    */
+    float GetStiffness(SpringStore::Type type) const;
+
+    /**
+    * @return the conjugate gradient iterations used last tick
+    */
+    int GetLastIterations() const { return m_lastIterations; }
+
+private:
+
+    /**
+    * Calculates the spring forces and the stiffness matrix of each spring
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    void CalculateForces(const ParticleStore& particles, const SpringStore& springs);
+
+    /**
+    * Multiplies a vector by the stiffness matrix of all springs
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent batches across
+    * @param input The vector to multiply
+    * @param output The result of the multiplication
+    */
+    void MultiplyStiffness(const SpringStore& springs,
+                           ThreadPool& threads,
+                           const std::vector<D3DXVECTOR3>& input,
+                           std::vector<D3DXVECTOR3>& output) const;
+
+    /**
+    * Multiplies a range of springs in a single batch with SSE
+    * @param springs The springs connecting the particles
+    * @param begin/end The range of springs in the batch
+    * @param input The vector to multiply
+    * @param output The result of the multiplication
+    */
+    void MultiplyBatch(const SpringStore& springs,
+                       int begin, int end,
+                       const std::vector<D3DXVECTOR3>& input,
+                       std::vector<D3DXVECTOR3>& output) const;
+
+    /**
+    * Multiplies a vector by the system matrix (I + h^2K)
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent batches across
+    * @param timestepSqr Delta time squared
+    * @param input The vector to multiply
+    * @param output The result of the multiplication
+    */
+    void MultiplySystem(const SpringStore& springs,
+                        ThreadPool& threads,
+                        float timestepSqr,
+                        const std::vector<D3DXVECTOR3>& input,
+                        std::vector<D3DXVECTOR3>& output) const;
+
+    /**
+    * Zeroes the values for any particles that cannot move
+    * @param values The vector to filter
+    */
+    void Filter(std::vector<D3DXVECTOR3>& values) const;
+
+    /**
+    * Matrix components of a spring
+    */
+    enum Component
+    {
+        XX, XY, XZ, YY, YZ, ZZ,
+        MAX_COMPONENTS
+    };
+
+    float m_stiffness[SpringStore::MAX_TYPES];  ///< Spring constant for each type of spring
+    int m_stride = 0;                           ///< Padded number of springs for each component
+    int m_lastIterations = 0;                   ///< Conjugate gradient iterations used last tick
+    std::vector<float> m_jacobian;              ///< Stiffness matrix components of each spring
+    std::vector<unsigned char> m_fixed;         ///< Whether each particle cannot move this tick
+    std::vector<D3DXVECTOR3> m_velocity;        ///< Velocity of each particle at the start of the tick
+    std::vector<D3DXVECTOR3> m_force;           ///< Spring and external forces on each particle
+    std::vector<D3DXVECTOR3> m_deltaVelocity;   ///< Solved change in velocity
+    std::vector<D3DXVECTOR3> m_residual;        ///< Conjugate gradient residual
+    std::vector<D3DXVECTOR3> m_direction;       ///< Conjugate gradient search direction
+    std::vector<D3DXVECTOR3> m_product;         ///< System matrix multiplied by the search direction
+    std::vector<D3DXVECTOR3> m_preconditioned;  ///< Residual multiplied by the preconditioner
+    std::vector<D3DXVECTOR3> m_inverseDiagonal; ///< Inverse of the system matrix diagonal
+};
@@ -0,0 +1,254 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - multigridsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "multigridsolver.h"
+#include "springstore.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    const int LEVEL_ITERATIONS = 2;  ///< Initial iterations for each coarse grid
+    const int MINIMUM_LENGTH = 4;    ///< Smallest side length for a coarse grid
+
+    /**
+    * Neighbouring offsets connected by springs in a coarse grid
+    */
+    const int SPRING_OFFSETS[][2] = { {1, 0}, {0, 1}, {1, 1}, {-1, 1} };
+}
+
+MultigridSolver::MultigridSolver()
+    : m_levelIterations(LEVEL_ITERATIONS)
+{
+}
+
+void MultigridSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    m_levels.clear();
+    m_gridLength = particles.GetGridLength();
+    if(m_gridLength * m_gridLength != particles.Size() ||
+       particles.GetGridSpacing() <= 0.0f)
+    {
+        m_gridLength = 0;
+        return;
+    }
+
+    const std::vector<D3DXVECTOR3>* positions = &particles.GetPositions();
+    const std::vector<unsigned char>* flags = &particles.GetFlags();
+    int length = m_gridLength;
+    float spacing = particles.GetGridSpacing();
+
+    m_levels.reserve(32);
+    while((length + 1) / 2 >= MINIMUM_LENGTH)
+    {
+        m_levels.emplace_back();
+        Level& level = m_levels.back();
+        level.length = (length + 1) / 2;
+        spacing *= 2.0f;
+        Restrict(level, *positions, *flags, length);
+
+        /* Springs connect each particle to its horizontal, vertical and
+        diagonal neighbours. Each direction is split in two by alternating
+        along the row so no two springs of the same batch share a particle.
+        Rest lengths come from the grid spacing rather than the current
+        positions so any stretch or folds in the cloth aren't kept */
+
+        for(const auto& offset : SPRING_OFFSETS)
+        {
+            const float restLength = spacing * std::sqrt(static_cast<float>(
+                (offset[0] * offset[0]) + (offset[1] * offset[1])));
+
+            for(int color = 0; color < 2; ++color)
+            {
+                level.batches.push_back(static_cast<int>(level.restLength.size()));
+                for(int y = 0; y < level.length - offset[1]; ++y)
+                {
+                    for(int x = max(0, -offset[0]); x < min(level.length, level.length - offset[0]); ++x)
+                    {
+                        const int parity = offset[0] == 0 ? y : x;
+                        if(parity % 2 == color)
+                        {
+                            const int p1 = (y * level.length) + x;
+                            const int p2 = ((y + offset[1]) * level.length) + x + offset[0];
+                            level.indices.push_back(p1);
+                            level.indices.push_back(p2);
+                            level.restLength.push_back(restLength);
+                        }
+                    }
+                }
+            }
+        }
+        level.batches.push_back(static_cast<int>(level.restLength.size()));
+
+        positions = &level.positions;
+        flags = &level.flags;
+        length = level.length;
+    }
+}
+
+void MultigridSolver::Solve(ParticleStore& particles,
+                            const SpringStore& springs,
+                            ThreadPool& threads,
+                            const SolverSettings& settings)
+{
+    if(m_gridLength != particles.GetGridLength())
+    {
+        Initialise(particles, springs);
+    }
+
+    if(!m_levels.empty())
+    {
+        // Take the current positions down to the coarsest grid
+        Restrict(m_levels[0], particles.GetPositions(), particles.GetFlags(), m_gridLength);
+        for(int i = 1; i < GetLevels(); ++i)
+        {
+            const Level& finer = m_levels[i-1];
+            Restrict(m_levels[i], finer.positions, finer.flags, finer.length);
+        }
+
+        // Solve each grid and carry its corrections up to the cloth
+        for(int i = GetLevels() - 1; i > 0; --i)
+        {
+            Level& finer = m_levels[i-1];
+            SolveLevel(m_levels[i], threads);
+            Prolong(m_levels[i], threads, finer.positions, finer.flags, finer.length);
+        }
+        SolveLevel(m_levels[0], threads);
+        Prolong(m_levels[0], threads, particles.GetPositions(), particles.GetFlags(), m_gridLength);
+    }
+
+    m_accelerator.Solve(particles, springs, threads, settings);
+    particles.Integrate(settings.damping, settings.timestepSquared);
+}
+
+void MultigridSolver::Restrict(Level& level,
+                               const std::vector<D3DXVECTOR3>& positions,
+                               const std::vector<unsigned char>& flags,
+                               int length) const
+{
+    const int count = level.length * level.length;
+    level.positions.resize(count);
+    level.flags.resize(count);
+
+    std::fill(level.flags.begin(), level.flags.end(), 0);
+    for(int y = 0; y < level.length; ++y)
+    {
+        for(int x = 0; x < level.length; ++x)
+        {
+            const int coarse = (y * level.length) + x;
+            level.positions[coarse] = positions[(y * 2 * length) + (x * 2)];
+        }
+    }
+
+    // Pins between coarse particles hold all coarse particles interpolated onto them
+    for(int y = 0; y < length; ++y)
+    {
+        for(int x = 0; x < length; ++x)
+        {
+            if(flags[(y * length) + x] & ParticleStore::PINNED)
+            {
+                const int x0 = min(x / 2, level.length - 1);
+                const int x1 = min((x + 1) / 2, level.length - 1);
+                const int y0 = min(y / 2, level.length - 1);
+                const int y1 = min((y + 1) / 2, level.length - 1);
+                level.flags[(y0 * level.length) + x0] = ParticleStore::PINNED;
+                level.flags[(y0 * level.length) + x1] = ParticleStore::PINNED;
+                level.flags[(y1 * level.length) + x0] = ParticleStore::PINNED;
+                level.flags[(y1 * level.length) + x1] = ParticleStore::PINNED;
+            }
+        }
+    }
+    level.restricted = level.positions;
+}
+
+void MultigridSolver::SolveLevel(Level& level, ThreadPool& threads) const
+{
+    std::vector<D3DXVECTOR3>& positions = level.positions;
+    for(int j = 0; j < m_levelIterations; ++j)
+    {
+        for(int i = 0; i < static_cast<int>(level.batches.size()) - 1; ++i)
+        {
+            const int begin = level.batches[i];
+            threads.ParallelFor(level.batches[i + 1] - begin, [&](int start, int end)
+            {
+                for(int k = begin + start; k < begin + end; ++k)
+                {
+                    // Coarse springs only resist stretching to allow the cloth to fold
+                    const std::uint32_t p1 = level.indices[k*2];
+                    const std::uint32_t p2 = level.indices[k*2+1];
+                    const D3DXVECTOR3 difference(positions[p2] - positions[p1]);
+                    const float length = D3DXVec3Length(&difference);
+                    if(length <= level.restLength[k])
+                    {
+                        continue;
+                    }
+
+                    const float w1 = level.flags[p1] ? 0.0f : 1.0f;
+                    const float w2 = level.flags[p2] ? 0.0f : 1.0f;
+                    if((w1 + w2) == 0.0f)
+                    {
+                        continue;
+                    }
+
+                    const D3DXVECTOR3 correction(difference * 
+                        ((length - level.restLength[k]) / (length * (w1 + w2))));
+                    positions[p1] += correction * w1;
+                    positions[p2] -= correction * w2;
+                }
+            });
+        }
+    }
+}
+
+void MultigridSolver::Prolong(const Level& level,
+                              ThreadPool& threads,
+                              std::vector<D3DXVECTOR3>& positions,
+                              const std::vector<unsigned char>& flags,
+                              int length) const
+{
+    const int last = level.length - 1;
+    auto correction = [&level](int x, int y) -> D3DXVECTOR3
+    {
+        const int index = (y * level.length) + x;
+        return level.positions[index] - level.restricted[index];
+    };
+
+    // Particles between the coarse particles take the average of their corrections
+    threads.ParallelFor(length, [&](int begin, int end)
+    {
+        for(int y = begin; y < end; ++y)
+        {
+            const int y0 = min(y / 2, last);
+            const int y1 = min((y + 1) / 2, last);
+
+            for(int x = 0; x < length; ++x)
+            {
+                const int index = (y * length) + x;
+                if(flags[index] & (ParticleStore::PINNED|ParticleStore::SLEEPING))
+                {
+                    continue;
+                }
+
+                const int x0 = min(x / 2, last);
+                const int x1 = min((x + 1) / 2, last);
+                positions[index] += (correction(x0, y0) + correction(x1, y0) +
+                    correction(x0, y1) + correction(x1, y1)) * 0.25f;
+            }
+        }
+    });
+}
+
+void MultigridSolver::SetLevelIterations(int iterations)
+{
+    m_levelIterations = max(iterations, 0);
+}
+
+int MultigridSolver::GetLevelIterations() const
+{
+    return m_levelIterations;
+}
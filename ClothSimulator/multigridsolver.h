@@ -0,0 +1,124 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - multigridsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springaccelerator.h"
+#include "directx.h"
+
+#include <vector>
+#include <cstdint>
+
+/**
+* Hierarchical spring solver for grid cloths
+* Coarser grids are built by taking every second particle of the finer grid.
+* Each tick the coarse grids are solved first from the coarsest up, with the
+* change in position of each grid interpolated onto the next finer grid,
+* before the springs of the cloth are solved as normal. This corrects the
+* stretching across the whole cloth that the springs alone take many
+* iterations to remove.
+*/
+class MultigridSolver : public ISolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    MultigridSolver();
+
+    /**
+    * Builds the coarse grids when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "Multigrid"; }
+
+    /**
+    * @param iterations The number of iterations to solve each coarse grid
+    */
+    void SetLevelIterations(int iterations);
+
+    /**
+    * @return the number of iterations to solve each coarse grid
+    */
+    int GetLevelIterations() const;
+
+    /**
+    * @return the number of coarse grids
+    */
+    int GetLevels() const { return static_cast<int>(m_levels.size()); }
+
+private:
+
+    /**
+    * A single coarse grid
+    */
+    struct Level
+    {
+        int length = 0;                          ///< Particles along each side of the grid
+        std::vector<D3DXVECTOR3> positions;      ///< Current positions of the particles
+        std::vector<D3DXVECTOR3> restricted;     ///< Positions taken from the finer grid this tick
+        std::vector<unsigned char> flags;        ///< Pinned flags taken from the finer grid this tick
+        std::vector<std::uint32_t> indices;      ///< Pairs of particle indices connected by a spring
+        std::vector<float> restLength;           ///< Distance for each spring at rest
+        std::vector<int> batches;                ///< Offsets of each batch of independent springs
+    };
+
+    /**
+    * Copies every second particle of the finer grid into the coarse grid
+    * @param level The coarse grid to fill
+    * @param positions The positions of the finer grid
+    * @param flags The flags of the finer grid
+    * @param length The particles along each side of the finer grid
+    */
+    void Restrict(Level& level,
+                  const std::vector<D3DXVECTOR3>& positions,
+                  const std::vector<unsigned char>& flags,
+                  int length) const;
+
+    /**
+    * Solves the springs of a coarse grid
+    * @param level The coarse grid to solve
+    * @param threads The threads to split each batch across
+    */
+    void SolveLevel(Level& level, ThreadPool& threads) const;
+
+    /**
+    * Interpolates the change in position of a coarse grid onto the finer grid
+    * @param level The solved coarse grid
+    * @param threads The threads to split the rows across
+    * @param positions The positions of the finer grid
+    * @param flags The flags of the finer grid
+    * @param length The particles along each side of the finer grid
+    */
+    void Prolong(const Level& level,
+                 ThreadPool& threads,
+                 std::vector<D3DXVECTOR3>& positions,
+                 const std::vector<unsigned char>& flags,
+                 int length) const;
+
+    int m_levelIterations;           ///< Number of iterations to solve each coarse grid
+    int m_gridLength = 0;            ///< Particles along each side of the cloth grid
+    std::vector<Level> m_levels;     ///< Coarse grids from the finest to the coarsest
+    SpringAccelerator m_accelerator; ///< Runs the spring iterations of the cloth
+};
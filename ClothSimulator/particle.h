@@ -4,14 +4,15 @@
 
 #pragma once
 
+#include "particlestore.h"
 #include "dynamicmesh.h"
-#include "callbacks.h"
 
 class Diagnostic;
 class Shader;
 
 /**
 * A sphere representing a vertex on the cloth
+* Lightweight view of a single particle held in the particle store
 */
 class Particle
 {
@@ -19,23 +20,14 @@ public:
 
     /**
     * Constructor
-    * @param engine Callbacks from the rendering engine
-    */
-    explicit Particle(EnginePtr engine);
-
-    /**
-    * Create the particle
-    * @param position The intial position of the particle
-    * @param uv The uvs for the particle
+    * @param store The store holding the particle data
     * @param index The internal index of the particle
-    * @param mesh The template collision mesh to copy
-    * @param visualRadius The radius to render the markers 
     */
-    void Initialise(const D3DXVECTOR3& position, 
-                    const D3DXVECTOR2& uv, 
-                    unsigned int index, 
-                    const CollisionMesh& mesh, 
-                    float visualRadius);
+    Particle(ParticleStore& store, unsigned int index)
+        : m_store(&store)
+        , m_index(index)
+    {
+    }
 
     /**
     * Draws the particle visual mesh
@@ -43,8 +35,8 @@ public:
     * @param view The view matrix
     * @param position The position to set the visual mesh
     */
-    void DrawVisualMesh(const Matrix& projection, 
-                        const Matrix& view, 
+    void DrawVisualMesh(const Matrix& projection,
+                        const Matrix& view,
                         const D3DXVECTOR3& position);
 
     /**
@@ -57,49 +49,44 @@ public:
     /**
     * @return the particle collision mesh object
     */
-    CollisionMesh& GetCollisionMesh();
-
-    /**
-    * Resets the particle back to its initial position
-    */
-    void ResetPosition();
+    DynamicMesh& GetCollisionMesh() { return m_store->GetCollisionMesh(m_index); }
 
     /**
     * Adds force to the particle
     * @param force The force to add
     */
-    void AddForce(const D3DXVECTOR3& force);
+    void AddForce(const D3DXVECTOR3& force) { m_store->AddForce(m_index, force); }
 
     /**
     * @return whether particle is pinned
     */
-    bool IsPinned() const { return m_pinned; };
+    bool IsPinned() const { return m_store->HasFlag(m_index, ParticleStore::PINNED); }
 
     /**
     * @param pin Set whether the particle is pinned
     */
-    void PinParticle(bool pin);
+    void PinParticle(bool pin) { m_store->SetFlag(m_index, ParticleStore::PINNED, pin); }
 
     /**
     * @return whether particle is selected
     */
-    bool IsSelected() const { return m_selected; };
+    bool IsSelected() const { return m_store->HasFlag(m_index, ParticleStore::SELECTED); }
 
     /**
     * @param select Set whether particle is selected
     */
-    void SelectParticle(bool select);
+    void SelectParticle(bool select) { m_store->SetFlag(m_index, ParticleStore::SELECTED, select); }
 
     /**
     * Move a particle explicitly
     * @param position The position to move to
     */
-    void MovePosition(const D3DXVECTOR3& position);
+    void MovePosition(const D3DXVECTOR3& position) { m_store->MovePosition(m_index, position); }
 
     /**
     * @return whether the particle should undergo smoothing or not
     */
-    bool RequiresSmoothing() const;
+    bool RequiresSmoothing() const { return !m_store->HasFlag(m_index, ParticleStore::HULL_COLLIDING); }
 
     /**
     * @return the internal index of the particle
@@ -109,30 +96,18 @@ public:
     /**
     * @return the position of the particle in world coordinates
     */
-    const D3DXVECTOR3& GetPosition() const { return m_position; }
+    const D3DXVECTOR3& GetPosition() const { return m_store->GetPosition(m_index); }
 
     /**
     * @return the uvs for the particle
     */
-    const D3DXVECTOR2& GetUVs() const { return m_uvs; }
-
-    /**
-    * Update the particles position
-    * @param damping The damping to apply to the movement
-    * @param timestepSqr Delta time squared
-    */
-    void PreCollisionUpdate(float damping, float timestepSqr);
+    const D3DXVECTOR2& GetUVs() const { return m_store->GetUVs(m_index); }
 
     /**
     * Sets the colour of the visual particle mesh
     * @param colour The colour to set to in rgb
     */
-    void SetColor(const D3DXVECTOR3& colour);
-
-    /**
-    * Updates the required values post collision resolution
-    */
-    void PostCollisionUpdate();
+    void SetColor(const D3DXVECTOR3& colour) { m_store->SetColor(m_index, colour); }
 
     /**
     * Updates diagnostics for this particle
@@ -142,38 +117,6 @@ public:
 
 private:
 
-    /**
-    * Updates the particle's collision with the cached position
-    */
-    void UpdateCollisionPosition();
-
-    /**
-    * Filters the y component of the position delta
-    * @note this is to prevent jittering of the convex hull algorithm
-    * and can be removed once Persistent contact caching is in place
-    */
-    void FilterPosition();
-
-    /**
-    * Prevent copying
-    */
-    Particle(const Particle&);
-    Particle& operator=(const Particle&);
-
-private:
-             
-    D3DXVECTOR3 m_positionDelta;                 ///< Change in position between current and previous positions
-    D3DXVECTOR3 m_previousPosition;              ///< Current previous position this tick
-    D3DXVECTOR3 m_position;                      ///< Current position in world coordinates of particle
-    D3DXVECTOR3 m_acceleration;                  ///< Current acceleration of particle
-    D3DXVECTOR3 m_initialPosition;               ///< Initial position of particle 
-    D3DXVECTOR2 m_uvs;                           ///< Texture uvs for the particle
-    Transform m_transform;                       ///< Current transform of particle
-    bool m_selected = false;                     ///< Whether particle is selected or not
-    bool m_pinned = false;                       ///< Whether particle is pinned or not
-    unsigned int m_index = 0;                    ///< Internal index of the particle
-    D3DXVECTOR3 m_color;                         ///< Color of the particle
-    std::shared_ptr<DynamicMesh> m_collision;    ///< collision geometry for particle
-    float m_visualRadius = 0.0f;                 ///< Visual render radius for particle markers
-    std::deque<float> m_yFiltering;              ///< Filtering of the y component for position
+    ParticleStore* m_store;  ///< Store holding the particle data
+    unsigned int m_index;    ///< Internal index of the particle
 };
\ No newline at end of file
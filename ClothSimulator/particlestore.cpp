@@ -0,0 +1,609 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - particlestore.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "particlestore.h"
+#include "dynamicmesh.h"
+
+#include <algorithm>
+#include <emmintrin.h>
+#include <cstring>
+
+namespace
+{
+    const int MAX_FILTERING = 5;         ///< Maximum values used for filtering
+    const float PARTICLE_MASS = 1.0f;    ///< Mass in kg for single particle
+    const int SIMD_WIDTH = 4;            ///< Particles integrated together with SSE
+    const int TILE_LENGTH = 8;           ///< Particles along each side of a sleeping tile
+    const int SLEEP_TICKS = 30;          ///< Ticks a tile must rest for before sleeping
+    const float SLEEP_DISTANCE = 0.01f;  ///< Most a particle can drift from where it began resting
+    const float WAKE_DISTANCE = 0.02f;   ///< Least movement that disturbs a sleeping tile
+
+    static_assert(sizeof(D3DXVECTOR3) == sizeof(float) * 3,
+        "Integration requires tightly packed position components");
+
+    /**
+    * Reorders the values of each particle to their new indices
+    * @param values The values to reorder, with width values for each particle
+    * @param source The old index for each new index or -1 if the particle is new
+    * @param width The number of values held for each particle
+    * @param fill The value to give new particles
+    */
+    template<typename T>
+    void Remap(std::vector<T>& values, const std::vector<int>& source, int width, const T& fill)
+    {
+        std::vector<T> remapped(source.size() * width, fill);
+        for(unsigned int i = 0; i < source.size(); ++i)
+        {
+            if(source[i] >= 0)
+            {
+                std::copy(values.begin() + (source[i] * width),
+                    values.begin() + ((source[i] + 1) * width),
+                    remapped.begin() + (i * width));
+            }
+        }
+        values.swap(remapped);
+    }
+}
+
+ParticleStore::ParticleStore(EnginePtr engine)
+    : m_engine(engine)
+{
+}
+
+ParticleStore::~ParticleStore()
+{
+}
+
+void ParticleStore::Resize(int count)
+{
+    const int current = Size();
+    ResizeCollision(count);
+
+    m_position.resize(count);
+    m_previousPosition.resize(count);
+    m_acceleration.resize(count);
+    m_flags.resize(count);
+    m_interactingVelocity.resize(count);
+    m_initialPosition.resize(count);
+    m_positionDelta.resize(count);
+    m_restPosition.resize(count);
+    m_uvs.resize(count);
+    m_color.resize(count);
+    m_yFiltering.resize(count * MAX_FILTERING);
+
+    for(int i = current; i < count; ++i)
+    {
+        m_flags[i] = 0;
+        m_color[i] = D3DXVECTOR3(0.0f, 0.0f, 1.0f);
+    }
+}
+
+void ParticleStore::ResizeCollision(int count)
+{
+    const int current = static_cast<int>(m_collision.size());
+    for(int i = count; i < current; ++i)
+    {
+        m_engine->octree()->RemoveObject(*m_collision[i]);
+    }
+
+    m_collision.resize(count);
+    for(int i = current; i < count; ++i)
+    {
+        m_collision[i].reset(new DynamicMesh(m_engine, std::bind(
+            &ParticleStore::MovePosition, this, i, std::placeholders::_1)));
+    }
+}
+
+void ParticleStore::ResizeGrid(int length, const CollisionMesh& mesh, std::vector<int>& added)
+{
+    // Find the particle each index of the new grid takes its state from
+    const int oldLength = m_gridLength;
+    const int shift = (length / 2) - (oldLength / 2);
+    const int count = length * length;
+
+    std::vector<int> source(count, -1);
+    for(int y = 0; y < length; ++y)
+    {
+        for(int x = 0; x < length; ++x)
+        {
+            const int oldX = x - shift;
+            const int oldY = y - shift;
+            if(oldX >= 0 && oldX < oldLength && oldY >= 0 && oldY < oldLength)
+            {
+                source[(y * length) + x] = (oldY * oldLength) + oldX;
+            }
+        }
+    }
+
+    const D3DXVECTOR3 zero(0.0f, 0.0f, 0.0f);
+    Remap(m_position, source, 1, zero);
+    Remap(m_previousPosition, source, 1, zero);
+    Remap(m_acceleration, source, 1, zero);
+    Remap(m_flags, source, 1, static_cast<unsigned char>(0));
+    Remap(m_interactingVelocity, source, 1, zero);
+    Remap(m_initialPosition, source, 1, zero);
+    Remap(m_positionDelta, source, 1, zero);
+    Remap(m_restPosition, source, 1, zero);
+    Remap(m_uvs, source, 1, D3DXVECTOR2(0.0f, 0.0f));
+    Remap(m_color, source, 1, D3DXVECTOR3(0.0f, 0.0f, 1.0f));
+    Remap(m_yFiltering, source, MAX_FILTERING, 0.0f);
+
+    // Collision meshes belong to an index rather than a particle so
+    // only those for the indices added or removed are changed
+    ResizeCollision(count);
+
+    added.clear();
+    for(int i = 0; i < count; ++i)
+    {
+        if(source[i] < 0)
+        {
+            added.push_back(i);
+            continue;
+        }
+
+        DynamicMesh& collision = *m_collision[i];
+        if(!collision.HasGeometry())
+        {
+            collision.LoadInstance(mesh);
+            m_engine->octree()->AddObject(collision);
+        }
+        collision.PositionalNonParentalUpdate(m_position[i]);
+        collision.SetRenderSolverDiagnostics(false);
+    }
+
+    SetGridLength(length);
+}
+
+void ParticleStore::Rescale(const D3DXVECTOR3& origin, float scale, const CollisionMesh& mesh)
+{
+    // Find where the origin has moved to from the average displacement of the particles
+    const int count = Size();
+    D3DXVECTOR3 offset(0.0f, 0.0f, 0.0f);
+    for(int i = 0; i < count; ++i)
+    {
+        offset += m_position[i] - m_initialPosition[i];
+    }
+    const D3DXVECTOR3 moved(count > 0 ? origin + (offset / static_cast<float>(count)) : origin);
+
+    for(int i = 0; i < count; ++i)
+    {
+        m_initialPosition[i] = origin + ((m_initialPosition[i] - origin) * scale);
+        m_position[i] = moved + ((m_position[i] - moved) * scale);
+        m_previousPosition[i] = moved + ((m_previousPosition[i] - moved) * scale);
+        m_restPosition[i] = moved + ((m_restPosition[i] - moved) * scale);
+        m_positionDelta[i] *= scale;
+
+        m_collision[i]->LoadInstance(mesh);
+        m_collision[i]->PositionalNonParentalUpdate(m_position[i]);
+    }
+
+    for(float& value : m_yFiltering)
+    {
+        value *= scale;
+    }
+
+    WakeAll();
+}
+
+void ParticleStore::Initialise(int index,
+                               const D3DXVECTOR3& position,
+                               const D3DXVECTOR2& uv,
+                               const CollisionMesh& mesh)
+{
+    m_uvs[index] = uv;
+    m_initialPosition[index] = position;
+    m_position[index] = position;
+    m_previousPosition[index] = position;
+    MakeZeroVector(m_acceleration[index]);
+    MakeZeroVector(m_positionDelta[index]);
+
+    std::fill(m_yFiltering.begin() + (index * MAX_FILTERING),
+        m_yFiltering.begin() + ((index + 1) * MAX_FILTERING), 0.0f);
+
+    const bool firstInitialisation = !m_collision[index]->HasGeometry();
+    m_collision[index]->LoadInstance(mesh);
+    m_collision[index]->PositionalNonParentalUpdate(position);
+    m_collision[index]->SetRenderSolverDiagnostics(false);
+    CacheCollisionState(index);
+
+    if(firstInitialisation)
+    {
+        m_engine->octree()->AddObject(*m_collision[index]);
+    }
+}
+
+void ParticleStore::SetFlag(int index, Flag flag, bool set)
+{
+    // Pinning or grabbing a particle disturbs the tile it rests in
+    if((flag & (PINNED|SELECTED)) && (((m_flags[index] & flag) != 0) != set))
+    {
+        WakeTile(GetTile(index));
+    }
+
+    if(set)
+    {
+        m_flags[index] |= flag;
+    }
+    else
+    {
+        m_flags[index] &= ~flag;
+    }
+}
+
+void ParticleStore::AddForce(const D3DXVECTOR3& force)
+{
+    const D3DXVECTOR3 acceleration(force / PARTICLE_MASS);
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        if(!(m_flags[i] & PINNED))
+        {
+            m_acceleration[i] += acceleration;
+        }
+    }
+}
+
+void ParticleStore::AddForce(int index, const D3DXVECTOR3& force)
+{
+    if(!(m_flags[index] & PINNED))
+    {
+        WakeTile(GetTile(index));
+        m_acceleration[index] += force / PARTICLE_MASS;
+    }
+}
+
+void ParticleStore::Integrate(float damping, float timestepSqr)
+{
+    //verlet integration
+    //X(t + dt) = X(t) + (X(t)-X(t - dt)) + dt^2X''(t)
+    const int count = Size();
+    const int blockCount = count - (count % SIMD_WIDTH);
+
+    const __m128 damp = _mm_set1_ps(damping);
+    const __m128 dtSqr = _mm_set1_ps(timestepSqr);
+    const __m128i immovable = _mm_set1_epi32(PINNED|COLLIDING|SLEEPING);
+    const __m128i zero = _mm_setzero_si128();
+
+    // Four particles span three registers of interleaved xyz components
+    for(int i = 0; i < blockCount; i += SIMD_WIDTH)
+    {
+        float* position = &m_position[i].x;
+        float* previous = &m_previousPosition[i].x;
+        float* acceleration = &m_acceleration[i].x;
+
+        // Expand the flags into a mask for each particle that can move
+        int flags = 0;
+        memcpy(&flags, &m_flags[i], SIMD_WIDTH);
+        __m128i flagsWide = _mm_unpacklo_epi8(_mm_cvtsi32_si128(flags), zero);
+        flagsWide = _mm_unpacklo_epi16(flagsWide, zero);
+        const __m128 movable = _mm_castsi128_ps(_mm_cmpeq_epi32(
+            _mm_and_si128(flagsWide, immovable), zero));
+
+        // Spread the particle masks over the xyz components
+        __m128 mask[3];
+        mask[0] = _mm_shuffle_ps(movable, movable, _MM_SHUFFLE(1,0,0,0));
+        mask[1] = _mm_shuffle_ps(movable, movable, _MM_SHUFFLE(2,2,1,1));
+        mask[2] = _mm_shuffle_ps(movable, movable, _MM_SHUFFLE(3,3,3,2));
+
+        for(int j = 0; j < 3; ++j)
+        {
+            const int offset = j * SIMD_WIDTH;
+            const __m128 current = _mm_loadu_ps(position + offset);
+            const __m128 update = _mm_add_ps(
+                _mm_mul_ps(_mm_sub_ps(current, _mm_loadu_ps(previous + offset)), damp),
+                _mm_mul_ps(_mm_loadu_ps(acceleration + offset), dtSqr));
+
+            _mm_storeu_ps(previous + offset, current);
+            _mm_storeu_ps(position + offset, _mm_add_ps(current, _mm_and_ps(update, mask[j])));
+        }
+    }
+
+    for(int i = blockCount; i < count; ++i)
+    {
+        if(!(m_flags[i] & (PINNED|COLLIDING|SLEEPING)))
+        {
+            const D3DXVECTOR3 update = ((m_position[i]-m_previousPosition[i])*damping)
+                + (m_acceleration[i]*timestepSqr);
+
+            m_previousPosition[i] = m_position[i];
+            m_position[i] += update;
+        }
+        else
+        {
+            m_previousPosition[i] = m_position[i];
+        }
+    }
+}
+
+void ParticleStore::ClearForces()
+{
+    std::fill(m_acceleration.begin(), m_acceleration.end(), D3DXVECTOR3(0.0f, 0.0f, 0.0f));
+}
+
+void ParticleStore::UpdateCollisionPositions()
+{
+    // Solvers move particles without syncing the collision meshes
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        if(!(m_flags[i] & SLEEPING))
+        {
+            UpdateCollisionPosition(i);
+        }
+    }
+}
+
+void ParticleStore::SaveTickPositions()
+{
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        UpdateCollisionPosition(i);
+        m_collision[i]->SaveTickPosition();
+    }
+}
+
+void ParticleStore::MovePosition(int index, const D3DXVECTOR3& translation)
+{
+    if(!(m_flags[index] & PINNED))
+    {
+        // Sleeping particles ignore small pushes such as resting contact
+        if(m_flags[index] & SLEEPING)
+        {
+            if(D3DXVec3LengthSq(&translation) <= WAKE_DISTANCE * WAKE_DISTANCE)
+            {
+                return;
+            }
+            WakeTile(GetTile(index));
+        }
+
+        m_position[index] += translation;
+        UpdateCollisionPosition(index);
+    }
+}
+
+void ParticleStore::ResetPositions()
+{
+    WakeAll();
+    std::fill(m_yFiltering.begin(), m_yFiltering.end(), 0.0f);
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        MakeZeroVector(m_positionDelta[i]);
+        m_previousPosition[i] = m_position[i] = m_initialPosition[i];
+        m_collision[i]->PositionalNonParentalUpdate(m_position[i]);
+    }
+}
+
+void ParticleStore::UpdateCollisionPosition(int index)
+{
+    if(m_collision[index]->GetPosition() != m_position[index])
+    {
+        m_collision[index]->PositionalNonParentalUpdate(m_position[index]);
+    }
+}
+
+void ParticleStore::CacheCollisionState(int index)
+{
+    const DynamicMesh& collision = *m_collision[index];
+    m_interactingVelocity[index] = collision.GetInteractingVelocity();
+
+    SetFlag(index, COLLIDING, !collision.IsCollidingWith(Geometry::NONE));
+    SetFlag(index, HULL_COLLIDING, collision.IsCollidingWith(Geometry::BOX)
+        || collision.IsCollidingWith(Geometry::CYLINDER));
+}
+
+void ParticleStore::FilterPositions()
+{
+    // Each particle owns a ring buffer of values sharing the same head
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        if(m_flags[i] & SLEEPING)
+        {
+            continue;
+        }
+
+        D3DXVECTOR3& delta = m_positionDelta[i];
+        delta = m_position[i] - m_previousPosition[i];
+
+        float* filtering = &m_yFiltering[i * MAX_FILTERING];
+        filtering[m_filterIndex] = delta.y;
+
+        // Only consider changes in y position that is greater than threshold
+        float amount = delta.y;
+        int amountCount = 1;
+        const float threshold = 0.1f;
+        for(int j = 0; j < MAX_FILTERING; ++j)
+        {
+            if(fabs(delta.y - filtering[j]) > threshold)
+            {
+                amount += filtering[j];
+                amountCount++;
+            }
+        }
+
+        delta.y = amount / static_cast<float>(amountCount);
+        m_position[i] = m_previousPosition[i] + delta;
+    }
+    m_filterIndex = (m_filterIndex + 1) % MAX_FILTERING;
+}
+
+void ParticleStore::PostCollisionUpdate()
+{
+    FilterPositions();
+
+    // Update the collision mesh last after all movement has been decided
+    const int count = Size();
+    for(int i = 0; i < count; ++i)
+    {
+        UpdateCollisionPosition(i);
+        m_collision[i]->UpdateCollision();
+        CacheCollisionState(i);
+    }
+
+    if(m_allowSleeping)
+    {
+        UpdateSleeping();
+    }
+}
+
+void ParticleStore::SetGridLength(int length)
+{
+    m_gridLength = length;
+    m_tileLength = (length + TILE_LENGTH - 1) / TILE_LENGTH;
+
+    for(unsigned int i = 0; i < m_flags.size(); ++i)
+    {
+        m_flags[i] &= ~SLEEPING;
+    }
+
+    m_sleepingTiles = 0;
+    m_stillTicks.assign(m_tileLength * m_tileLength, 0);
+    m_tileSleeping.assign(m_tileLength * m_tileLength, 0);
+}
+
+void ParticleStore::SetSleeping(bool allow)
+{
+    m_allowSleeping = allow;
+    if(!allow)
+    {
+        WakeAll();
+    }
+}
+
+bool ParticleStore::IsAsleep() const
+{
+    return !m_tileSleeping.empty() && 
+        m_sleepingTiles == static_cast<int>(m_tileSleeping.size());
+}
+
+void ParticleStore::WakeAll()
+{
+    for(unsigned int i = 0; i < m_tileSleeping.size(); ++i)
+    {
+        WakeTile(i);
+        m_stillTicks[i] = 0;
+    }
+}
+
+int ParticleStore::GetTile(int index) const
+{
+    if(m_gridLength == 0)
+    {
+        return -1;
+    }
+
+    const int x = (index % m_gridLength) / TILE_LENGTH;
+    const int y = (index / m_gridLength) / TILE_LENGTH;
+    return (y * m_tileLength) + x;
+}
+
+void ParticleStore::SleepTile(int tile)
+{
+    const int tileX = (tile % m_tileLength) * TILE_LENGTH;
+    const int tileY = (tile / m_tileLength) * TILE_LENGTH;
+
+    for(int y = tileY; y < min(tileY + TILE_LENGTH, m_gridLength); ++y)
+    {
+        for(int x = tileX; x < min(tileX + TILE_LENGTH, m_gridLength); ++x)
+        {
+            const int index = (y * m_gridLength) + x;
+            // Rest at the last solved state rather than the verlet prediction
+            m_flags[index] |= SLEEPING;
+            m_position[index] = m_previousPosition[index];
+            MakeZeroVector(m_positionDelta[index]);
+            UpdateCollisionPosition(index);
+        }
+    }
+
+    m_tileSleeping[tile] = 1;
+    ++m_sleepingTiles;
+}
+
+void ParticleStore::WakeTile(int tile)
+{
+    if(tile < 0 || !m_tileSleeping[tile])
+    {
+        return;
+    }
+
+    const int tileX = (tile % m_tileLength) * TILE_LENGTH;
+    const int tileY = (tile / m_tileLength) * TILE_LENGTH;
+
+    for(int y = tileY; y < min(tileY + TILE_LENGTH, m_gridLength); ++y)
+    {
+        for(int x = tileX; x < min(tileX + TILE_LENGTH, m_gridLength); ++x)
+        {
+            m_flags[(y * m_gridLength) + x] &= ~SLEEPING;
+        }
+    }
+
+    m_tileSleeping[tile] = 0;
+    m_stillTicks[tile] = 0;
+    --m_sleepingTiles;
+}
+
+void ParticleStore::UpdateSleeping()
+{
+    const float sleepDistanceSqr = SLEEP_DISTANCE * SLEEP_DISTANCE;
+    const float wakeDistanceSqr = WAKE_DISTANCE * WAKE_DISTANCE;
+
+    for(int tileY = 0; tileY < m_tileLength; ++tileY)
+    {
+        for(int tileX = 0; tileX < m_tileLength; ++tileX)
+        {
+            const int tile = (tileY * m_tileLength) + tileX;
+            if(m_tileSleeping[tile])
+            {
+                continue;
+            }
+
+            // Find the largest drift of any particle in the tile since it began resting
+            // Measuring over many ticks ignores the constant offset of each verlet prediction
+            float movement = 0.0f;
+            const bool starting = m_stillTicks[tile] == 0;
+            const int startX = tileX * TILE_LENGTH;
+            const int startY = tileY * TILE_LENGTH;
+            for(int y = startY; y < min(startY + TILE_LENGTH, m_gridLength); ++y)
+            {
+                for(int x = startX; x < min(startX + TILE_LENGTH, m_gridLength); ++x)
+                {
+                    const int index = (y * m_gridLength) + x;
+                    if(starting)
+                    {
+                        m_restPosition[index] = m_position[index];
+                    }
+                    else
+                    {
+                        const D3DXVECTOR3 drift(m_position[index] - m_restPosition[index]);
+                        movement = max(movement, D3DXVec3LengthSq(&drift));
+                    }
+                }
+            }
+
+            if(movement <= sleepDistanceSqr)
+            {
+                if(++m_stillTicks[tile] >= SLEEP_TICKS)
+                {
+                    SleepTile(tile);
+                }
+                continue;
+            }
+
+            m_stillTicks[tile] = 0;
+            if(movement > wakeDistanceSqr)
+            {
+                // A moving tile disturbs any neighbouring tiles resting against it
+                for(int y = max(tileY - 1, 0); y <= min(tileY + 1, m_tileLength - 1); ++y)
+                {
+                    for(int x = max(tileX - 1, 0); x <= min(tileX + 1, m_tileLength - 1); ++x)
+                    {
+                        WakeTile((y * m_tileLength) + x);
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,380 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - particlestore.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "callbacks.h"
+
+class CollisionMesh;
+class DynamicMesh;
+
+/**
+* Contiguous structure-of-arrays storage for all cloth particles
+* Hot simulation data is held in separate linear arrays so each
+* pass over the cloth streams through memory without pointer chasing
+*/
+class ParticleStore
+{
+public:
+
+    /**
+    * Particle state bit flags
+    */
+    enum Flag
+    {
+        PINNED = 1,          ///< Particle is pinned and will not move
+        SELECTED = 2,        ///< Particle is selected in handle mode
+        COLLIDING = 4,       ///< Particle collided with a scene object last tick
+        HULL_COLLIDING = 8,  ///< Particle collided with a box or cylinder last tick
+        SLEEPING = 16        ///< Particle is in a resting tile and will not move
+    };
+
+    /**
+    * Constructor
+    * @param engine Callbacks from the rendering engine
+    */
+    explicit ParticleStore(EnginePtr engine);
+
+    /**
+    * Destructor
+    */
+    ~ParticleStore();
+
+    /**
+    * Resizes the store, removing and adding collision meshes to the octree
+    * @param count The number of particles to hold
+    */
+    void Resize(int count);
+
+    /**
+    * Initialises a single particle
+    * @param index The index of the particle
+    * @param position The intial position of the particle
+    * @param uv The uvs for the particle
+    * @param mesh The template collision mesh to copy
+    */
+    void Initialise(int index,
+                    const D3DXVECTOR3& position,
+                    const D3DXVECTOR2& uv,
+                    const CollisionMesh& mesh);
+
+    /**
+    * Changes the length of the grid, keeping the state of particles that remain in the
+    * grid and only creating or removing collision meshes for the rows and columns added
+    * or removed. The grid stays centered so the change is split across both sides.
+    * @param length The particles along each side of the new grid
+    * @param mesh The template collision mesh to copy for any new collision meshes
+    * @param added Filled with the indices of particles that require initialising
+    */
+    void ResizeGrid(int length, const CollisionMesh& mesh, std::vector<int>& added);
+
+    /**
+    * Scales the spacing of all particles in place. The initial positions scale about the
+    * origin while the simulated positions scale about where the origin has moved to.
+    * @param origin The initial position to scale about
+    * @param scale The amount to scale the distance between particles by
+    * @param mesh The rescaled template collision mesh to copy
+    */
+    void Rescale(const D3DXVECTOR3& origin, float scale, const CollisionMesh& mesh);
+
+    /**
+    * @return the number of particles in the store
+    */
+    int Size() const { return static_cast<int>(m_position.size()); }
+
+    /**
+    * Adds force to all unpinned particles
+    * @param force The force to add
+    */
+    void AddForce(const D3DXVECTOR3& force);
+
+    /**
+    * Adds force to a single particle if unpinned
+    * @param index The index of the particle
+    * @param force The force to add
+    */
+    void AddForce(int index, const D3DXVECTOR3& force);
+
+    /**
+    * Verlet integrates all particles using their current acceleration
+    * @param damping The damping to apply to the movement
+    * @param timestepSqr Delta time squared
+    */
+    void Integrate(float damping, float timestepSqr);
+
+    /**
+    * Removes all accumulated forces once the tick has been integrated
+    */
+    void ClearForces();
+
+    /**
+    * Syncs all collision meshes with their particle positions
+    */
+    void UpdateCollisionPositions();
+
+    /**
+    * Saves the particle positions at the start of a tick for the collision meshes
+    * to sweep from, so particles placed directly between ticks don't sweep
+    */
+    void SaveTickPositions();
+
+    /**
+    * Move a particle explicitly and update its collision mesh
+    * @param index The index of the particle
+    * @param translation The amount to move the particle by
+    */
+    void MovePosition(int index, const D3DXVECTOR3& translation);
+
+    /**
+    * Move an unpinned awake particle without updating its collision mesh
+    * @param index The index of the particle
+    * @param translation The amount to move the particle by
+    * @note the collision mesh is synced on the next call to UpdateCollisionPositions
+    */
+    void AdjustPosition(int index, const D3DXVECTOR3& translation)
+    {
+        if(!(m_flags[index] & (PINNED|SLEEPING)))
+        {
+            m_position[index] += translation;
+        }
+    }
+
+    /**
+    * Resets all particles back to their initial positions
+    */
+    void ResetPositions();
+
+    /**
+    * Filters, updates the collision meshes and caches
+    * their collision state for the next tick
+    */
+    void PostCollisionUpdate();
+
+    /**
+    * @param allow Whether tiles of the grid that have come to rest
+    *        are put to sleep until disturbed
+    */
+    void SetSleeping(bool allow);
+
+    /**
+    * Wakes all sleeping tiles of the grid
+    */
+    void WakeAll();
+
+    /**
+    * @return whether every tile of the grid is sleeping
+    */
+    bool IsAsleep() const;
+
+    /**
+    * @return the number of tiles of the grid that are sleeping
+    */
+    int GetSleepingTiles() const { return m_sleepingTiles; }
+
+    /**
+    * @return the number of tiles the grid is split into for sleeping
+    */
+    int GetTileCount() const { return static_cast<int>(m_tileSleeping.size()); }
+
+    /**
+    * @param index The index of the particle
+    * @param flag The flag to query
+    * @return whether the flag is set for the particle
+    */
+    bool HasFlag(int index, Flag flag) const { return (m_flags[index] & flag) != 0; }
+
+    /**
+    * @param index The index of the particle
+    * @param flag The flag to set
+    * @param set Whether to set or clear the flag
+    */
+    void SetFlag(int index, Flag flag, bool set);
+
+    /**
+    * @return the positions of all particles in world coordinates
+    */
+    const std::vector<D3DXVECTOR3>& GetPositions() const { return m_position; }
+
+    /**
+    * @return the writable positions of all particles in world coordinates
+    * @note collision meshes are not updated until UpdateCollisionPositions
+    */
+    std::vector<D3DXVECTOR3>& GetPositions() { return m_position; }
+
+    /**
+    * @return the writable positions of all particles before the last integration
+    */
+    std::vector<D3DXVECTOR3>& GetPreviousPositions() { return m_previousPosition; }
+
+    /**
+    * @return the accumulated acceleration of all particles this tick
+    */
+    const std::vector<D3DXVECTOR3>& GetAccelerations() const { return m_acceleration; }
+
+    /**
+    * @return the velocity of any interacting collision bodies last tick
+    */
+    const std::vector<D3DXVECTOR3>& GetInteractingVelocities() const { return m_interactingVelocity; }
+
+    /**
+    * @return the particle flags
+    */
+    const std::vector<unsigned char>& GetFlags() const { return m_flags; }
+
+    /**
+    * @param index The index of the particle
+    * @return the position of the particle in world coordinates
+    */
+    const D3DXVECTOR3& GetPosition(int index) const { return m_position[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @return the change in position after filtering last tick
+    */
+    const D3DXVECTOR3& GetPositionDelta(int index) const { return m_positionDelta[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @return the uvs for the particle
+    */
+    const D3DXVECTOR2& GetUVs(int index) const { return m_uvs[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @param uv The uvs for the particle
+    */
+    void SetUVs(int index, const D3DXVECTOR2& uv) { m_uvs[index] = uv; }
+
+    /**
+    * @param index The index of the particle
+    * @return the colour of the particle visual mesh
+    */
+    const D3DXVECTOR3& GetColor(int index) const { return m_color[index]; }
+
+    /**
+    * @param index The index of the particle
+    * @param colour The colour to set to in rgb
+    */
+    void SetColor(int index, const D3DXVECTOR3& colour) { m_color[index] = colour; }
+
+    /**
+    * @param radius The radius to render the particle markers
+    */
+    void SetVisualRadius(float radius) { m_visualRadius = radius; }
+
+    /**
+    * @return the radius to render the particle markers
+    */
+    float GetVisualRadius() const { return m_visualRadius; }
+
+    /**
+    * Sets the grid size and splits it into tiles for sleeping
+    * @param length The particles along each side of the square grid
+    *        the particles are indexed by, or 0 if not a grid
+    */
+    void SetGridLength(int length);
+
+    /**
+    * @return the particles along each side of the grid or 0 if not a grid
+    */
+    int GetGridLength() const { return m_gridLength; }
+
+    /**
+    * @param spacing The distance between neighbouring particles of the grid at rest
+    */
+    void SetGridSpacing(float spacing) { m_gridSpacing = spacing; }
+
+    /**
+    * @return the distance between neighbouring particles of the grid at rest
+    */
+    float GetGridSpacing() const { return m_gridSpacing; }
+
+    /**
+    * @param index The index of the particle
+    * @return the particle collision mesh object
+    */
+    DynamicMesh& GetCollisionMesh(int index) { return *m_collision[index]; }
+
+private:
+
+    /**
+    * Resizes the collision meshes, removing and adding them to the octree
+    * @param count The number of collision meshes to hold
+    */
+    void ResizeCollision(int count);
+
+    /**
+    * Updates the particle's collision with its cached position
+    * @param index The index of the particle
+    */
+    void UpdateCollisionPosition(int index);
+
+    /**
+    * Caches the collision state of the particle from its collision mesh
+    * @param index The index of the particle
+    */
+    void CacheCollisionState(int index);
+
+    /**
+    * Filters the y component of the position delta for all particles
+    * @note this is to prevent jittering of the convex hull algorithm
+    * and can be removed once Persistent contact caching is in place
+    */
+    void FilterPositions();
+
+    /**
+    * Counts how long each awake tile has stayed near its resting positions and
+    * puts it to sleep once it has rested long enough, waking the neighbours of moving tiles
+    */
+    void UpdateSleeping();
+
+    /**
+    * Puts all particles in a tile to sleep
+    * @param tile The index of the tile
+    */
+    void SleepTile(int tile);
+
+    /**
+    * Wakes all particles in a tile if it is sleeping
+    * @param tile The index of the tile
+    */
+    void WakeTile(int tile);
+
+    /**
+    * @param index The index of the particle
+    * @return the index of the tile the particle belongs to
+    */
+    int GetTile(int index) const;
+
+    /**
+    * Prevent copying
+    */
+    ParticleStore(const ParticleStore&);
+    ParticleStore& operator=(const ParticleStore&);
+
+private:
+
+    EnginePtr m_engine;                                    ///< Callbacks for the rendering engine
+    std::vector<D3DXVECTOR3> m_position;                   ///< Current positions in world coordinates
+    std::vector<D3DXVECTOR3> m_previousPosition;           ///< Previous positions this tick
+    std::vector<D3DXVECTOR3> m_acceleration;               ///< Current accelerations
+    std::vector<unsigned char> m_flags;                    ///< Particle state bit flags
+    std::vector<D3DXVECTOR3> m_interactingVelocity;        ///< Cached velocity of interacting collision bodies
+    std::vector<D3DXVECTOR3> m_initialPosition;            ///< Initial positions
+    std::vector<D3DXVECTOR3> m_positionDelta;              ///< Filtered change in position last tick
+    std::vector<D3DXVECTOR3> m_restPosition;               ///< Positions when the tile began resting
+    std::vector<D3DXVECTOR2> m_uvs;                        ///< Texture uvs for the particles
+    std::vector<D3DXVECTOR3> m_color;                      ///< Colours of the particle visual meshes
+    std::vector<float> m_yFiltering;                       ///< Ring buffers of the y component for filtering
+    int m_filterIndex = 0;                                 ///< Shared ring buffer index for filtering
+    float m_visualRadius = 0.0f;                           ///< Visual render radius for particle markers
+    int m_gridLength = 0;                                  ///< Particles along each side of the grid
+    float m_gridSpacing = 0.0f;                            ///< Distance between grid neighbours at rest
+    int m_tileLength = 0;                                  ///< Tiles along each side of the grid
+    bool m_allowSleeping = true;                           ///< Whether resting tiles are put to sleep
+    int m_sleepingTiles = 0;                               ///< Number of tiles currently sleeping
+    std::vector<int> m_stillTicks;                         ///< Ticks each tile has been resting for
+    std::vector<unsigned char> m_tileSleeping;             ///< Whether each tile is sleeping
+    std::vector<std::shared_ptr<DynamicMesh>> m_collision; ///< Collision geometry for each particle
+};
@@ -0,0 +1,194 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - projectivesolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "projectivesolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "utils.h"
+
+namespace
+{
+    const float STRETCH_WEIGHT = 100.0f;  ///< Initial weight for stretch springs
+    const float SHEAR_WEIGHT = 20.0f;     ///< Initial weight for shear springs
+    const float BEND_WEIGHT = 2.0f;       ///< Initial weight for bending springs
+}
+
+ProjectiveSolver::ProjectiveSolver()
+{
+    m_weight[SpringStore::STRETCH] = STRETCH_WEIGHT;
+    m_weight[SpringStore::SHEAR] = SHEAR_WEIGHT;
+    m_weight[SpringStore::BEND] = BEND_WEIGHT;
+}
+
+void ProjectiveSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    m_inertia.resize(particles.Size());
+    m_rhs.resize(particles.Size());
+    m_projection.resize(springs.Size());
+    m_requiresFactorisation = true;
+}
+
+void ProjectiveSolver::Solve(ParticleStore& particles,
+                             const SpringStore& springs,
+                             ThreadPool& threads,
+                             const SolverSettings& settings)
+{
+    if(static_cast<int>(m_projection.size()) != springs.Size() ||
+       static_cast<int>(m_inertia.size()) != particles.Size())
+    {
+        Initialise(particles, springs);
+    }
+
+    if(m_requiresFactorisation || 
+       settings.timestepSquared != m_factorisedTimestep || 
+       HasPinsChanged(particles))
+    {
+        Factorise(particles, springs, settings.timestepSquared);
+    }
+
+    // The verlet prediction is the inertial target and initial guess
+    particles.Integrate(settings.damping, settings.timestepSquared);
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+    m_inertia = positions;
+
+    if(m_system.Size() != particles.Size())
+    {
+        return;
+    }
+
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const std::vector<float>& restLength = springs.GetRestLengths();
+    const std::vector<unsigned char>& types = springs.GetTypes();
+    const float inverseTimestepSqr = 1.0f / settings.timestepSquared;
+    const int count = particles.Size();
+
+    for(int iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+        // Local step: project every spring to its rest length independently
+        threads.ParallelFor(springs.Size(), [&](int begin, int end)
+        {
+            for(int i = begin; i < end; ++i)
+            {
+                D3DXVECTOR3 difference(positions[indices[i*2]] - positions[indices[i*2+1]]);
+                const float length = D3DXVec3Length(&difference);
+                m_projection[i] = length > 0.0f ? difference * (restLength[i] / length) : difference;
+            }
+        });
+
+        // Global step: combine the projections with the inertia of the particles
+        for(int i = 0; i < count; ++i)
+        {
+            m_rhs[i] = m_pinned[i] ? positions[i] : m_inertia[i] * inverseTimestepSqr;
+        }
+
+        for(int i = 0; i < springs.Size(); ++i)
+        {
+            const std::uint32_t p1 = indices[i*2];
+            const std::uint32_t p2 = indices[i*2+1];
+            const D3DXVECTOR3 projection(m_projection[i] * m_weight[types[i]]);
+
+            // Pinned particles are known and move to the right hand side
+            if(!m_pinned[p1])
+            {
+                m_rhs[p1] += projection;
+                if(m_pinned[p2])
+                {
+                    m_rhs[p1] += positions[p2] * m_weight[types[i]];
+                }
+            }
+            if(!m_pinned[p2])
+            {
+                m_rhs[p2] -= projection;
+                if(m_pinned[p1])
+                {
+                    m_rhs[p2] += positions[p1] * m_weight[types[i]];
+                }
+            }
+        }
+
+        m_system.Solve(m_rhs);
+        positions.swap(m_rhs);
+    }
+}
+
+void ProjectiveSolver::Factorise(const ParticleStore& particles, 
+                                 const SpringStore& springs, 
+                                 float timestepSqr)
+{
+    const int count = particles.Size();
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const std::vector<unsigned char>& types = springs.GetTypes();
+
+    m_pinned.resize(count);
+    for(int i = 0; i < count; ++i)
+    {
+        m_pinned[i] = particles.HasFlag(i, ParticleStore::PINNED);
+    }
+
+    // System is M/h^2 + sum(w * L) with pinned rows replaced by the identity
+    std::vector<SparseCholesky::Entry> entries;
+    entries.reserve(count + (springs.Size() * 3));
+
+    for(int i = 0; i < count; ++i)
+    {
+        SparseCholesky::Entry entry = { i, i, m_pinned[i] ? 1.0 : 1.0 / timestepSqr };
+        entries.push_back(entry);
+    }
+
+    for(int i = 0; i < springs.Size(); ++i)
+    {
+        const int p1 = static_cast<int>(indices[i*2]);
+        const int p2 = static_cast<int>(indices[i*2+1]);
+        const double weight = m_weight[types[i]];
+
+        if(!m_pinned[p1])
+        {
+            SparseCholesky::Entry entry = { p1, p1, weight };
+            entries.push_back(entry);
+        }
+        if(!m_pinned[p2])
+        {
+            SparseCholesky::Entry entry = { p2, p2, weight };
+            entries.push_back(entry);
+        }
+        if(!m_pinned[p1] && !m_pinned[p2])
+        {
+            SparseCholesky::Entry entry = { max(p1, p2), min(p1, p2), -weight };
+            entries.push_back(entry);
+        }
+    }
+
+    if(!m_system.Factorise(count, entries))
+    {
+        ShowMessageBox("Projective dynamics system is not positive definite");
+    }
+
+    ++m_factorisations;
+    m_factorisedTimestep = timestepSqr;
+    m_requiresFactorisation = false;
+}
+
+bool ProjectiveSolver::HasPinsChanged(const ParticleStore& particles) const
+{
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+    for(unsigned int i = 0; i < flags.size(); ++i)
+    {
+        if(((flags[i] & ParticleStore::PINNED) != 0) != (m_pinned[i] != 0))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ProjectiveSolver::SetWeight(SpringStore::Type type, float weight)
+{
+    m_weight[type] = max(weight, 0.0f);
+    m_requiresFactorisation = true;
+}
+
+float ProjectiveSolver::GetWeight(SpringStore::Type type) const
+{
+    return m_weight[type];
+}
@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - projectivesolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springstore.h"
+#include "sparsecholesky.h"
+
+#include <vector>
+
+/**
+* Projective dynamics solver
+* Each iteration projects every spring to its rest length in parallel and then
+* solves a global system combining the projections with the inertia of the
+* particles. The global system only depends on the topology, timestep and pins
+* and is factorised once and reused until one of these changes.
+*/
+class ProjectiveSolver : public ISolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    ProjectiveSolver();
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "Projective"; }
+
+    /**
+    * Sets the weight for a type of spring, requiring a new factorisation
+    * @param type The type of spring to set
+    * @param weight The stiffness of the springs relative to the particle inertia
+    */
+    void SetWeight(SpringStore::Type type, float weight);
+
+    /**
+    * @param type The type of spring to query
+    * @return the weight for the type of spring
+    */
+    float GetWeight(SpringStore::Type type) const;
+
+    /**
+    * @return the number of times the global system has been factorised
+    */
+    int GetFactorisations() const { return m_factorisations; }
+
+private:
+
+    /**
+    * Factorises the global system for the current springs, timestep and pins
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param timestepSqr Delta time squared
+    */
+    void Factorise(const ParticleStore& particles, const SpringStore& springs, float timestepSqr);
+
+    /**
+    * @return whether the pins have changed since the last factorisation
+    * @param particles The store holding the particle data
+    */
+    bool HasPinsChanged(const ParticleStore& particles) const;
+
+    float m_weight[SpringStore::MAX_TYPES];     ///< Stiffness for each type of spring
+    SparseCholesky m_system;                    ///< Factorised global system
+    bool m_requiresFactorisation = true;        ///< Whether the global system needs to be factorised
+    float m_factorisedTimestep = 0.0f;          ///< Timestep squared used for the factorisation
+    int m_factorisations = 0;                   ///< Number of times the system has been factorised
+    std::vector<unsigned char> m_pinned;        ///< Pinned particles used for the factorisation
+    std::vector<D3DXVECTOR3> m_inertia;         ///< Predicted positions from the particle velocities
+    std::vector<D3DXVECTOR3> m_projection;      ///< Projected difference between each spring's particles
+    std::vector<D3DXVECTOR3> m_rhs;             ///< Right hand side of the global system
+};
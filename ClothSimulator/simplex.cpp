@@ -21,35 +21,44 @@ Edge::Edge()
     indices.assign(0);
 }
 
-Simplex::Simplex()
+void Simplex::Clear()
 {
-    const int maximumExpectedEdges = 20;
-    m_edges.reserve(maximumExpectedEdges);
+    m_edgeCount = 0;
+    m_faceCount = 0;
+    m_visibleCount = 0;
+    m_pointCount = 0;
 }
 
 bool Simplex::IsLine() const
 {
-    return m_simplex.size() == POINTS_IN_EDGE;
+    return m_pointCount == POINTS_IN_EDGE;
 }
 
 bool Simplex::IsTetrahedron() const
 {
-    return m_simplex.size() == POINTS_IN_TETRAHEDRON;
+    return m_pointCount == POINTS_IN_TETRAHEDRON;
 }
 
 bool Simplex::IsTriPlane() const
 {
-    return m_simplex.size() == POINTS_IN_FACE;
+    return m_pointCount == POINTS_IN_FACE;
 }
 
-void Simplex::RemovePoint(const D3DXVECTOR3& point)
+void Simplex::RemovePoint(int index)
 {
-    m_simplex.erase(std::remove(m_simplex.begin(), m_simplex.end(), point), m_simplex.end()); 
+    assert(index >= 0 && index < m_pointCount);
+    std::copy(m_simplex.begin() + index + 1, 
+        m_simplex.begin() + m_pointCount, m_simplex.begin() + index);
+    --m_pointCount;
 }
 
 void Simplex::AddPoint(const D3DXVECTOR3& point)
 {
-    m_simplex.push_back(point);
+    assert(m_pointCount < MAX_POINTS);
+    if(m_pointCount < MAX_POINTS)
+    {
+        m_simplex[m_pointCount++] = point;
+    }
 }
 
 const D3DXVECTOR3& Simplex::GetPoint(int index) const
@@ -57,16 +66,12 @@ const D3DXVECTOR3& Simplex::GetPoint(int index) const
     return m_simplex[index];
 }
 
-const std::deque<D3DXVECTOR3>& Simplex::GetPoints() const
-{
-    return m_simplex;
-}
-
 void Simplex::GenerateFaces()
 {
     auto createFace = [this](int face, int i0, int i1, int i2, 
         const D3DXVECTOR3& u, const D3DXVECTOR3& v)
     {
+        m_faces[face].alive = true;
         m_faces[face].index = face;
         m_faces[face].indices[0] = i0;
         m_faces[face].indices[1] = i1;
@@ -86,8 +91,9 @@ void Simplex::GenerateFaces()
         assert(m_faces[face].distanceToOrigin >= 0.0f);
     };
 
-    assert(m_simplex.size() <= POINTS_IN_TETRAHEDRON);
-    m_faces.resize(POINTS_IN_TETRAHEDRON);
+    assert(m_pointCount <= POINTS_IN_TETRAHEDRON);
+    m_faceCount = POINTS_IN_TETRAHEDRON;
+    m_edgeCount = 0;
 
     const int A = 3;
     const int B = 0;
@@ -118,62 +124,83 @@ void Simplex::ExtendFace(const D3DXVECTOR3& point)
     // on the border of the highlighted ones. Reference:
     // http://www.eecs.tufts.edu/~mhorn01/comp163/algorithm.html
 
-    const int pointIndex = static_cast<int>(m_simplex.size());
-    m_simplex.push_back(point);
-    m_edges.clear();
+    if(m_pointCount == MAX_POINTS)
+    {
+        return;
+    }
+
+    const int pointIndex = m_pointCount;
+    m_edgeCount = 0;
+    m_visibleCount = 0;
 
     // Determine faces that the point is in front of
-    std::vector<int> visibleFaces;
-    for(const Face& face : m_faces)
+    int deadFaces = 0;
+    for(int i = 0; i < m_faceCount; ++i)
     {
+        const Face& face = m_faces[i];
         if(face.alive)
         {
             D3DXVECTOR3 faceToPoint = point - GetPoint(face.indices[0]);
             if(D3DXVec3Dot(&face.normal, &faceToPoint) > 0.0f)
             {
-                visibleFaces.push_back(face.index);
+                m_visibleFaces[m_visibleCount++] = face.index;
             }
         }
+        else
+        {
+            ++deadFaces;
+        }
     }
-    assert(!visibleFaces.empty());
+    assert(m_visibleCount > 0);
 
     // Find all border edges from the visible faces
     const int minimumFaces = 1;
-    if(visibleFaces.size() == minimumFaces)
+    if(m_visibleCount == minimumFaces)
     {
         // For a single face, all edges are on the border
-        for(const Edge& edge : m_faces[visibleFaces[0]].edges)
+        for(const Edge& edge : m_faces[m_visibleFaces[0]].edges)
         {
-            m_edges.push_back(edge);
+            AddBorderEdge(edge);
         }
     }
     else
     {
         // For multiple faces, determine the border edges
-        for(int index : visibleFaces)
+        for(int i = 0; i < m_visibleCount; ++i)
         {
-            FindBorderEdges(m_faces[index], visibleFaces);
+            FindBorderEdges(m_faces[m_visibleFaces[i]]);
         }
     }
-    assert(!m_edges.empty());
+    assert(m_edgeCount > 0);
+
+    // Leave the simplex as it is if the new faces can't be held
+    const int availableFaces = m_visibleCount + deadFaces + (MAX_FACES - m_faceCount);
+    if(m_edgeCount > availableFaces)
+    {
+        m_edgeCount = 0;
+        return;
+    }
+    m_simplex[m_pointCount++] = point;
 
     // Mark all visible faces as dead
-    for(int index : visibleFaces)
+    for(int i = 0; i < m_visibleCount; ++i)
     {
-        m_faces[index].alive = false;
+        m_faces[m_visibleFaces[i]].alive = false;
     }
     
     // Connect up new faces from the edges to the point
-    unsigned int visibleIndex = 0;
+    int visibleIndex = 0;
     bool hasDeadFaces = true;
     
-    for(const Edge& edge : m_edges)
+    for(int i = 0; i < m_edgeCount; ++i)
     {
+        const Edge& edge = m_edges[i];
+
         // Determine a new face to overwrite/create
         int faceIndex = -1;
-        if(visibleIndex < visibleFaces.size())
+        if(visibleIndex < m_visibleCount)
         {
-            faceIndex = visibleFaces[visibleIndex];
+            faceIndex = m_visibleFaces[visibleIndex];
             ++visibleIndex;
         }
         else
@@ -186,8 +213,7 @@ void Simplex::ExtendFace(const D3DXVECTOR3& point)
         
             if(!hasDeadFaces)
             {
-                faceIndex = m_faces.size();
-                m_faces.emplace_back();
+                faceIndex = m_faceCount++;
             }
         }
     
@@ -223,14 +249,23 @@ void Simplex::ExtendFace(const D3DXVECTOR3& point)
 
 int Simplex::GetDeadFaceIndex() const
 {
-    auto itr = std::find_if(m_faces.begin(), m_faces.end(), 
+    auto end = m_faces.begin() + m_faceCount;
+    auto itr = std::find_if(m_faces.begin(), end, 
         [](const Face& face){ return !face.alive; });
 
-    return itr == m_faces.end() ? -1 : itr->index;
+    return itr == end ? -1 : itr->index;
+}
+
+void Simplex::AddBorderEdge(const Edge& edge)
+{
+    assert(m_edgeCount < MAX_EDGES);
+    if(m_edgeCount < MAX_EDGES)
+    {
+        m_edges[m_edgeCount++] = edge;
+    }
 }
 
-void Simplex::FindBorderEdges(const Face& face, 
-                              const std::vector<int>& faces)
+void Simplex::FindBorderEdges(const Face& face)
 {
     // Can have a maximum of 2 border edges per face
     int borderCounter = 0;
@@ -238,10 +273,10 @@ void Simplex::FindBorderEdges(const Face& face,
 
     for(const Edge& edge : face.edges)
     {
-        if(!IsSharedEdge(face.index, edge, faces))
+        if(!IsSharedEdge(face.index, edge))
         {
             ++borderCounter;
-            m_edges.push_back(edge);
+            AddBorderEdge(edge);
             if(borderCounter >= maxBorders)
             {
                 return;
@@ -250,11 +285,11 @@ void Simplex::FindBorderEdges(const Face& face,
     }
 }
 
-bool Simplex::IsSharedEdge(int index, const Edge& edge, const std::vector<int>& faces) const
+bool Simplex::IsSharedEdge(int index, const Edge& edge) const
 {
-    for(int faceindex : faces)
+    for(int i = 0; i < m_visibleCount; ++i)
     {
-        const Face& face = m_faces[faceindex];
+        const Face& face = m_faces[m_visibleFaces[i]];
         if(face.index == index || !face.alive)
         {
             continue;
@@ -303,7 +338,7 @@ D3DXVECTOR3 Simplex::GetFaceCenter(int faceindex) const
 const Face& Simplex::GetClosestFaceToOrigin()
 {
     int closest = 0;
-    for(unsigned int i = 0; i < m_faces.size(); ++i)
+    for(int i = 0; i < m_faceCount; ++i)
     {
         if(m_faces[i].alive && m_faces[i].distanceToOrigin
             < m_faces[closest].distanceToOrigin)
@@ -6,7 +6,6 @@
 
 #include "utils.h"
 
-#include <deque>
 #include <array>
 
 /**
@@ -43,15 +42,31 @@ struct Face
 /**
 * Holds points an n-dimensional simplex
 * For tetrahedron+ can generate and hold face information
+* All storage is fixed so a simplex can be cleared and reused without allocating
 */
 class Simplex
 {
 public:
 
     /**
-    * Constructor
+    * Most points held, enough for the tetrahedron and each expansion of its faces
+    */
+    static const int MAX_POINTS = 32;
+
+    /**
+    * Most faces held including those dead and waiting to be reused
+    */
+    static const int MAX_FACES = 64;
+
+    /**
+    * Most border edges found when extending the faces to a point
+    */
+    static const int MAX_EDGES = MAX_POINTS;
+
+    /**
+    * Removes all points, faces and edges
     */
-    Simplex();
+    void Clear();
 
     /**
     * @return whether the simplex is a line
@@ -70,13 +85,15 @@ public:
 
     /**
     * @param point The point to add to the simplex
+    * @note points past the capacity of the simplex are ignored
     */
     void AddPoint(const D3DXVECTOR3& point);
 
     /**
-    * @param point The point to remove from the simplex
+    * Removes a point, keeping the order of the points after it
+    * @param index The index of the point to remove
     */
-    void RemovePoint(const D3DXVECTOR3& point);
+    void RemovePoint(int index);
 
     /**
     * @param index The index for the simplex container
@@ -85,9 +102,9 @@ public:
     const D3DXVECTOR3& GetPoint(int index) const;
    
     /**
-    * @return the list of all points
+    * @return the number of points in the simplex
     */
-    const std::deque<D3DXVECTOR3>& GetPoints() const;
+    int GetPointCount() const { return m_pointCount; }
 
     /**
     * Generates the initial faces of a terminating simplex
@@ -98,18 +115,31 @@ public:
     /**
     * Connects the vertices of the current face with the given point
     * @param point The point to extend to
+    * @note points that would overflow the capacity of the simplex are ignored
     */
     void ExtendFace(const D3DXVECTOR3& point);
 
     /**
-    * @return the last generated border edges for the simplex
+    * @return the number of border edges last generated for the simplex
     */
-    const std::vector<Edge>& GetBorderEdges() const { return m_edges; }
+    int GetBorderEdgeCount() const { return m_edgeCount; }
 
     /**
-    * @return the faces for the simplex
+    * @param index The index for the border edge
+    * @return the border edge at the given index
     */
-    const std::deque<Face>& GetFaces() const { return m_faces; }
+    const Edge& GetBorderEdge(int index) const { return m_edges[index]; }
+
+    /**
+    * @return the number of faces for the simplex including dead faces
+    */
+    int GetFaceCount() const { return m_faceCount; }
+
+    /**
+    * @param index The index for the face
+    * @return the face at the given index
+    */
+    const Face& GetFace(int index) const { return m_faces[index]; }
 
     /**
     * @param faceindex The index for the face
@@ -139,20 +169,23 @@ private:
     bool AreEdgesEqual(const Edge& edge1, const Edge& edge2) const;
 
     /**
-    * Determines if the given edge exists among the comparison faces
+    * Determines if the given edge exists among the visible faces
     * @param index The face index the edge lives on
     * @param edge The edge to check for
-    * @param comparison A list of faces indices to search for the edge
-    * @return whether the given edge is shared amongst the given faces
+    * @return whether the given edge is shared amongst the visible faces
     */
-    bool IsSharedEdge(int index, const Edge& edge, const std::vector<int>& faces) const;
+    bool IsSharedEdge(int index, const Edge& edge) const;
 
     /**
-    * Fills the given container with any edges from the face that are border edges
+    * Fills the border edges with any edges from the face not shared with the visible faces
     * @param face The face to find the border edges for
-    * @param faces All possible connected faces to the face
     */
-    void FindBorderEdges(const Face& face, const std::vector<int>& faces);
+    void FindBorderEdges(const Face& face);
+
+    /**
+    * @param edge The border edge to add
+    */
+    void AddBorderEdge(const Edge& edge);
 
     /**
     * @return an index of a dead face
@@ -161,7 +194,12 @@ private:
 
 private:
 
-    std::vector<Edge> m_edges; ///< Found border edges for hull generation
-    std::deque<Face> m_faces; ///< faces for tetrahedron+ simplex points
-    std::deque<D3DXVECTOR3> m_simplex; ///< Internal simplex container
+    std::array<Edge, MAX_EDGES> m_edges;           ///< Found border edges for hull generation
+    std::array<Face, MAX_FACES> m_faces;           ///< faces for tetrahedron+ simplex points
+    std::array<int, MAX_FACES> m_visibleFaces;     ///< Faces the point being extended to is in front of
+    std::array<D3DXVECTOR3, MAX_POINTS> m_simplex; ///< Internal simplex container
+    int m_edgeCount = 0;                           ///< Number of border edges found
+    int m_faceCount = 0;                           ///< Number of faces including dead faces
+    int m_visibleCount = 0;                        ///< Number of faces the point is in front of
+    int m_pointCount = 0;                          ///< Number of points in the simplex
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 ////////////////////////////////////////////////////////////////////////////////////////
 
 #include "simulation.h"
+#include "utils.h"
 #include "cloth.h"
 #include "camera.h"
 #include "light.h"
@@ -14,6 +15,8 @@
 #include "scene.h"
 #include "octree.h"
 #include "collisionsolver.h"
+#include "threadpool.h"
+#include "particlestore.h"
 
 #include <algorithm>
 #include <sstream>
@@ -23,6 +26,9 @@ namespace
     const float CAMERA_MOVE_SPEED = 40.0f;  ///< Speed the camera will translate
     const float CAMERA_ROT_SPEED = 2.0f;    ///< Speed the camera will rotate
     const float HANDLE_SPEED = 20.0f;       ///< Speed the cloth will move in handle mode
+    const float PHYSICS_STEP = 1.0f/60.0f;  ///< Fixed time simulated by each physics tick
+    const int MAX_PHYSICS_STEPS = 4;        ///< Most physics ticks run in a single frame
+    const int MAX_CLOTHS = 4;               ///< Most cloths simulated in the scene at once
 
     const D3DCOLOR BACK_BUFFER_COLOR(D3DCOLOR_XRGB(190, 190, 195)); 
     const D3DCOLOR RENDER_COLOR(D3DCOLOR_XRGB(0, 0, 255));          
@@ -52,8 +58,11 @@ void Simulation::Render()
 
     D3DXVECTOR3 cameraPosition(m_camera->World().Position());
     m_scene->Draw(cameraPosition, m_camera->Projection(), m_camera->View());
-    m_cloth->Draw(cameraPosition, m_camera->Projection(), m_camera->View());
-    m_cloth->DrawCollisions(m_camera->Projection(), m_camera->View());
+    for(const auto& cloth : m_cloths)
+    {
+        cloth->Draw(cameraPosition, m_camera->Projection(), m_camera->View());
+        cloth->DrawCollisions(m_camera->Projection(), m_camera->View());
+    }
     m_scene->DrawCollisions(m_camera->Projection(), m_camera->View());
     m_scene->DrawTools(cameraPosition, m_camera->Projection(), m_camera->View());
     m_octree->RenderDiagnostics();
@@ -79,7 +88,10 @@ void Simulation::Update()
     {
         m_input->UpdatePicking(m_camera->Projection(), m_camera->World());
         m_scene->ManipulatorPickingTest(m_input->GetMousePicking());
-        m_cloth->MousePickingTest(m_input->GetMousePicking());
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->MousePickingTest(m_input->GetMousePicking());
+        }
         m_scene->ScenePickingTest(m_input->GetMousePicking());
         m_input->SolvePicking();
     }
@@ -88,13 +100,65 @@ void Simulation::Update()
     const bool pressed = m_input->IsClickPreventionActive() 
         ? false : m_input->IsMousePressed();
 
-    m_cloth->PreCollisionUpdate(deltatime);
     m_scene->PreCollisionUpdate(pressed, m_input->GetMouseDirection(),
         m_camera->World(), m_camera->InverseProjection(), deltatime);
 
-    m_scene->SolveCollisions();
-    m_cloth->PostCollisionUpdate();
+    // Simulate the real time passed in fixed ticks, dropping any time
+    // over the maximum ticks to prevent slow frames compounding
+    m_accumulator += m_timer->GetFrameTime();
+    int steps = 0;
+    for(; m_accumulator >= PHYSICS_STEP && steps < MAX_PHYSICS_STEPS; ++steps)
+    {
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->PreCollisionUpdate(PHYSICS_STEP);
+        }
+
+        // Each cloth only touches its own particles when solving
+        m_clothThreads->ParallelFor(static_cast<int>(m_cloths.size()), 
+            [this](int begin, int end)
+            {
+                for(int i = begin; i < end; ++i)
+                {
+                    m_cloths[i]->Solve();
+                }
+            });
+
+        m_scene->SolveCollisions();
+
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->PostCollisionUpdate();
+        }
+        m_accumulator -= PHYSICS_STEP;
+    }
+
+    if(m_accumulator >= PHYSICS_STEP)
+    {
+        m_droppedTime += m_accumulator - fmod(m_accumulator, PHYSICS_STEP);
+        m_accumulator = fmod(m_accumulator, PHYSICS_STEP);
+    }
+
     m_scene->PostCollisionUpdate();
+    for(const auto& cloth : m_cloths)
+    {
+        cloth->InterpolateVertexBuffer(m_accumulator / PHYSICS_STEP);
+    }
+
+    if(m_diagnostics->AllowDiagnostics(Diagnostic::TEXT))
+    {
+        m_diagnostics->UpdateText(Diagnostic::TEXT, "PhysicsSteps", 
+            Diagnostic::WHITE, StringCast(steps));
+
+        m_diagnostics->UpdateText(Diagnostic::TEXT, "Interpolation", 
+            Diagnostic::WHITE, StringCast(m_accumulator / PHYSICS_STEP));
+
+        m_diagnostics->UpdateText(Diagnostic::TEXT, "DroppedTime", 
+            Diagnostic::WHITE, StringCast(m_droppedTime));
+
+        m_diagnostics->UpdateText(Diagnostic::TEXT, "ClothCount", 
+            Diagnostic::WHITE, StringCast(m_cloths.size()));
+    }
 
     D3DPERF_EndEvent();
 }
@@ -104,11 +168,40 @@ void Simulation::LoadGuiCallbacks(GuiCallbacks* callbacks)
     using namespace std::placeholders;
     m_scene->LoadGuiCallbacks(callbacks);
 
-    callbacks->setGravity = std::bind(&Cloth::SetSimulation, m_cloth.get(), _1);
-    callbacks->resetCloth = std::bind(&Cloth::Reset, m_cloth.get());
-    callbacks->unpinCloth = std::bind(&Cloth::UnpinCloth, m_cloth.get());
+    // Simulation state is shared by all cloths, the cloth settings only control the gui cloth
+    callbacks->setGravity = [this](bool set)
+    {
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetSimulation(set);
+        }
+    };
+
+    callbacks->resetCloth = [this]()
+    {
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->Reset();
+        }
+    };
+
+    callbacks->unpinCloth = [this]()
+    {
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->UnpinCloth();
+        }
+    };
+
+    callbacks->setVertsVisible = [this](bool set)
+    {
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetVertexVisibility(set);
+        }
+    };
+
     callbacks->resetCamera = std::bind(&Camera::Reset, m_camera.get());
-    callbacks->setVertsVisible = std::bind(&Cloth::SetVertexVisibility, m_cloth.get(), _1);
     callbacks->setHandleMode = std::bind(&Cloth::SetHandleMode, m_cloth.get(), _1);
     callbacks->setWireframeMode = std::bind(&Diagnostic::SetWireframe, m_diagnostics.get(), _1);
 
@@ -121,11 +214,13 @@ void Simulation::LoadGuiCallbacks(GuiCallbacks* callbacks)
     callbacks->setVertexRows = std::bind(&Cloth::SetVertexRows, m_cloth.get(), _1);
     callbacks->setIterations = std::bind(&Cloth::SetIterations, m_cloth.get(), _1);
     callbacks->setSpacing = std::bind(&Cloth::SetSpacing, m_cloth.get(), _1);
+    callbacks->setSolver = std::bind(&Cloth::SetSolver, m_cloth.get(), _1);
 
     callbacks->getSpacing = std::bind(&Cloth::GetSpacing, m_cloth.get());
     callbacks->getIterations = std::bind(&Cloth::GetIterations, m_cloth.get());
     callbacks->getVertexRows = std::bind(&Cloth::GetVertexRows, m_cloth.get());
     callbacks->getTimestep = std::bind(&Cloth::GetTimeStep, m_cloth.get());
+    callbacks->getSolver = std::bind(&Cloth::GetSolver, m_cloth.get());
 }
 
 bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVICE9 d3ddev) 
@@ -169,8 +264,11 @@ bool Simulation::CreateSimulation(HINSTANCE hInstance, HWND hWnd, LPDIRECT3DDEVI
     m_octree.reset(octree);
 
     // Initialise the simulation
-    m_cloth.reset(new Cloth(engine));
-    m_solver.reset(new CollisionSolver(engine, m_cloth));
+    m_cloth.reset(new Cloth(engine, 0));
+    m_cloths.push_back(m_cloth);
+    m_clothThreads.reset(new ThreadPool(1));
+    m_solver.reset(new CollisionSolver(engine));
+    m_solver->SetCloths(m_cloths);
     m_scene.reset(new Scene(engine, m_solver));
 
     // Hook up the solver to the octree
@@ -262,6 +360,50 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
     m_input->SetKeyCallback(DIK_MINUS, true, 
         std::bind(&Cloth::ChangeSmoothing, m_cloth.get(), false));
 
+    // Cycling spring solver threads
+    m_input->SetKeyCallback(DIK_M, false, 
+        std::bind(&Cloth::ChangeThreadCount, m_cloth.get()));
+
+    // Toggling long range tethers
+    m_input->SetKeyCallback(DIK_L, false, 
+        std::bind(&Cloth::ToggleTethers, m_cloth.get()));
+
+    // Cycling spring convergence acceleration
+    m_input->SetKeyCallback(DIK_K, false, 
+        std::bind(&Cloth::ChangeAcceleration, m_cloth.get()));
+
+    // Toggling adaptive spring iterations
+    m_input->SetKeyCallback(DIK_J, false, 
+        std::bind(&Cloth::ToggleAdaptiveIterations, m_cloth.get()));
+
+    // Toggling sleeping of resting cloth tiles
+    m_input->SetKeyCallback(DIK_Z, false, 
+        std::bind(&Cloth::ToggleSleeping, m_cloth.get()));
+
+    // Toggling between the cloth grid and mesh
+    m_input->SetKeyCallback(DIK_O, false, 
+        std::bind(&Cloth::ToggleMesh, m_cloth.get()));
+
+    // Toggling swept collisions against the scene
+    m_input->SetKeyCallback(DIK_C, false, 
+        std::bind(&CollisionSolver::ToggleContinuousCollision, m_solver.get()));
+
+    // Toggling searching the scene shapes or their vertices for hull collisions
+    m_input->SetKeyCallback(DIK_V, false, 
+        std::bind(&CollisionSolver::ToggleAnalyticSupport, m_solver.get()));
+
+    // Toggling solving hull collisions from the particle center and radius
+    m_input->SetKeyCallback(DIK_B, false, 
+        std::bind(&CollisionSolver::ToggleCoreShapes, m_solver.get()));
+
+    // Toggling solving boxes and cylinders directly from their shape
+    m_input->SetKeyCallback(DIK_G, false, 
+        std::bind(&CollisionSolver::ToggleClosedFormHulls, m_solver.get()));
+
+    // Cycling the number of cloths
+    m_input->SetKeyCallback(DIK_N, false, 
+        std::bind(&Simulation::ChangeClothCount, this, engine));
+
     // Setting deltatime explicitly
     m_input->SetKeyCallback(DIK_P, false, 
         std::bind(&Timer::ToggleForceDeltatime, m_timer.get()));
@@ -297,11 +439,44 @@ void Simulation::LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine)
     m_input->SetKeyCallback(DIK_0, false, [this]()
     {
         m_drawCollisions = !m_drawCollisions;
-        m_cloth->SetCollisionVisibility(m_drawCollisions);
+        for(const auto& cloth : m_cloths)
+        {
+            cloth->SetCollisionVisibility(m_drawCollisions);
+        }
         m_scene->SetCollisionVisibility(m_drawCollisions);
     });
 
     // Toggle wall collision model diagnostics
     m_input->SetKeyCallback(DIK_9, false, 
         std::bind(&Scene::ToggleWallVisibility, m_scene.get()));   
+}
+
+void Simulation::ChangeClothCount(EnginePtr engine)
+{
+    if(static_cast<int>(m_cloths.size()) < MAX_CLOTHS)
+    {
+        // New cloths start above the others with the same settings as the gui cloth
+        std::shared_ptr<Cloth> cloth(new Cloth(engine, m_cloths.size()));
+        cloth->SetSpacing(m_cloth->GetSpacing());
+        cloth->SetVertexRows(m_cloth->GetVertexRows());
+        cloth->SetIterations(m_cloth->GetIterations());
+        cloth->SetTimeStep(m_cloth->GetTimeStep());
+        cloth->SetSolver(m_cloth->GetSolver());
+        cloth->SetSimulation(m_cloth->IsSimulating());
+        cloth->SetCollisionVisibility(m_drawCollisions);
+        m_cloths.push_back(cloth);
+    }
+    else
+    {
+        // Particles are explicitly removed from the octree before the cloth is destroyed
+        while(m_cloths.size() > 1)
+        {
+            m_cloths.back()->GetParticles().Resize(0);
+            m_cloths.pop_back();
+        }
+    }
+
+    m_solver->SetCloths(m_cloths);
+    m_clothThreads->SetThreadCount(min(static_cast<int>(m_cloths.size()), 
+        ThreadPool::GetMaxThreads()));
 }
\ No newline at end of file
@@ -15,6 +15,7 @@ class Cloth;
 class Input;
 class Timer;
 class Octree;
+class ThreadPool;
 
 /**
 * Main Simulation Class
@@ -74,6 +75,12 @@ private:
     */
     void LoadInput(HINSTANCE hInstance, HWND hWnd, EnginePtr engine);
 
+    /**
+    * Cycles the number of cloths in the scene
+    * @param engine Callbacks from the rendering engine
+    */
+    void ChangeClothCount(EnginePtr engine);
+
     /**
     * Prevent copying
     */
@@ -82,16 +89,20 @@ private:
 
 private:
 
-    std::unique_ptr<LightManager> m_light;       ///< Manager for the simulation lights
-    std::unique_ptr<ShaderManager> m_shader;     ///< Manager for the simulation shaders
-    std::shared_ptr<CollisionSolver> m_solver;   ///< Collision solver for cloth
-    std::unique_ptr<Timer> m_timer;              ///< Simulation timer object
-    std::shared_ptr<Cloth> m_cloth;              ///< Simulation cloth object
-    std::unique_ptr<Input> m_input;              ///< Simulation input object
-    std::unique_ptr<Camera> m_camera;            ///< Main camera
-    std::unique_ptr<Scene> m_scene;              ///< Mesh manager for the scene
-    std::unique_ptr<Diagnostic> m_diagnostics;   ///< Diagnostic renderer
-    std::unique_ptr<Octree> m_octree;            ///< Octree spatial partitining
-    LPDIRECT3DDEVICE9 m_d3ddev;                  ///< DirectX device
-    bool m_drawCollisions = false;               ///< Whether to display collision models
+    std::unique_ptr<LightManager> m_light;        ///< Manager for the simulation lights
+    std::unique_ptr<ShaderManager> m_shader;      ///< Manager for the simulation shaders
+    std::shared_ptr<CollisionSolver> m_solver;    ///< Collision solver for cloth
+    std::unique_ptr<Timer> m_timer;               ///< Simulation timer object
+    std::shared_ptr<Cloth> m_cloth;               ///< Simulation cloth object controlled by the gui
+    std::vector<std::shared_ptr<Cloth>> m_cloths; ///< All cloths in the scene, starting with the gui cloth
+    std::unique_ptr<ThreadPool> m_clothThreads;   ///< Threads for solving the cloths in parallel
+    std::unique_ptr<Input> m_input;               ///< Simulation input object
+    std::unique_ptr<Camera> m_camera;             ///< Main camera
+    std::unique_ptr<Scene> m_scene;               ///< Mesh manager for the scene
+    std::unique_ptr<Diagnostic> m_diagnostics;    ///< Diagnostic renderer
+    std::unique_ptr<Octree> m_octree;             ///< Octree spatial partitining
+    LPDIRECT3DDEVICE9 m_d3ddev;                   ///< DirectX device
+    bool m_drawCollisions = false;                ///< Whether to display collision models
+    float m_accumulator = 0.0f;                   ///< Real time not yet simulated in seconds
+    float m_droppedTime = 0.0f;                   ///< Real time skipped to keep up in seconds
 };
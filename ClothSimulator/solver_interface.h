@@ -0,0 +1,78 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - solver_interface.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+class ParticleStore;
+class SpringStore;
+class ThreadPool;
+
+/**
+* Results of stepping a solver
+*/
+struct SolverStats
+{
+    int iterations = 0;           ///< Number of spring iterations used last tick
+    float residual = 0.0f;        ///< Residual of the last spring iteration
+    double timeSaved = 0.0;       ///< Estimated nanoseconds saved by stopping before the maximum iterations
+    std::vector<float> residuals; ///< Residual of each spring iteration last tick
+};
+
+/**
+* Cloth values used when stepping a solver
+*/
+struct SolverSettings
+{
+    float timestep;          ///< Cloth physics timestep
+    float timestepSquared;   ///< Cloth timestep squared
+    float damping;           ///< Damping to apply to movement of particles
+    int iterations;          ///< Number of solver iterations per tick or the maximum if adaptive
+    int minimumIterations;   ///< Fewest spring iterations when adaptive
+    float tolerance;         ///< Residual to stop the spring iterations at or 0 to run them all
+    bool useMaximumResidual; ///< Whether the residual is the maximum rather than rms spring strain
+    float relaxation;        ///< Over-relaxation of each spring correction for spring iterations
+    float spectralRadius;    ///< Chebyshev weighting estimate for spring iterations or 0 for none
+    SolverStats* stats;      ///< If not null, receives the results of the spring iterations
+};
+
+/**
+* Public interface for the methods of moving the cloth particles each tick
+*/
+class ISolver
+{
+public:
+
+    /**
+    * Destructor
+    */
+    virtual ~ISolver() {}
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) = 0;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    * @note collision meshes are not synced with the new positions
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) = 0;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const = 0;
+};
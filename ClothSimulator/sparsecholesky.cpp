@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - sparsecholesky.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "sparsecholesky.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool SparseCholesky::Factorise(int size, const std::vector<Entry>& entries)
+{
+    // Find the envelope of each row
+    m_firstColumn.resize(size);
+    for(int i = 0; i < size; ++i)
+    {
+        m_firstColumn[i] = i;
+    }
+    for(const Entry& entry : entries)
+    {
+        int& first = m_firstColumn[entry.row];
+        first = std::min(first, entry.column);
+    }
+
+    m_rowStart.resize(size + 1);
+    m_rowStart[0] = 0;
+    for(int i = 0; i < size; ++i)
+    {
+        m_rowStart[i + 1] = m_rowStart[i] + (i - m_firstColumn[i]) + 1;
+    }
+
+    m_values.assign(m_rowStart[size], 0.0);
+    m_solution.resize(size * 3);
+    for(const Entry& entry : entries)
+    {
+        m_values[m_rowStart[entry.row] + entry.column - m_firstColumn[entry.row]] += entry.value;
+    }
+
+    // Factorise row by row where L(i,j) only depends on the rows above
+    for(int i = 0; i < size; ++i)
+    {
+        const int row = m_rowStart[i] - m_firstColumn[i];
+        for(int j = m_firstColumn[i]; j < i; ++j)
+        {
+            const int above = m_rowStart[j] - m_firstColumn[j];
+            double sum = m_values[row + j];
+            for(int k = std::max(m_firstColumn[i], m_firstColumn[j]); k < j; ++k)
+            {
+                sum -= m_values[row + k] * m_values[above + k];
+            }
+            m_values[row + j] = sum / m_values[above + j];
+        }
+
+        double diagonal = m_values[row + i];
+        for(int k = m_firstColumn[i]; k < i; ++k)
+        {
+            diagonal -= m_values[row + k] * m_values[row + k];
+        }
+
+        if(diagonal <= 0.0)
+        {
+            m_firstColumn.clear();
+            m_values.clear();
+            return false;
+        }
+        m_values[row + i] = std::sqrt(diagonal);
+    }
+    return true;
+}
+
+void SparseCholesky::Solve(std::vector<D3DXVECTOR3>& values) const
+{
+    // All three components are solved together to read the factor once
+    const int size = Size();
+    double* solution = m_solution.data();
+
+    // Forward substitution with L
+    for(int i = 0; i < size; ++i)
+    {
+        const int row = m_rowStart[i] - m_firstColumn[i];
+        double x = values[i].x;
+        double y = values[i].y;
+        double z = values[i].z;
+        for(int k = m_firstColumn[i]; k < i; ++k)
+        {
+            const double value = m_values[row + k];
+            x -= value * solution[k*3];
+            y -= value * solution[k*3+1];
+            z -= value * solution[k*3+2];
+        }
+        const double diagonal = m_values[row + i];
+        solution[i*3] = x / diagonal;
+        solution[i*3+1] = y / diagonal;
+        solution[i*3+2] = z / diagonal;
+    }
+
+    // Back substitution with the transpose of L
+    for(int i = size - 1; i >= 0; --i)
+    {
+        const int row = m_rowStart[i] - m_firstColumn[i];
+        const double diagonal = m_values[row + i];
+        const double x = solution[i*3] / diagonal;
+        const double y = solution[i*3+1] / diagonal;
+        const double z = solution[i*3+2] / diagonal;
+        for(int k = m_firstColumn[i]; k < i; ++k)
+        {
+            const double value = m_values[row + k];
+            solution[k*3] -= value * x;
+            solution[k*3+1] -= value * y;
+            solution[k*3+2] -= value * z;
+        }
+        values[i] = D3DXVECTOR3(static_cast<float>(x), 
+            static_cast<float>(y), static_cast<float>(z));
+    }
+}
@@ -0,0 +1,60 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - sparsecholesky.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "directx.h"
+
+#include <vector>
+
+/**
+* Cholesky factorisation of a sparse symmetric positive definite matrix
+* Only the envelope of each row from its first non-zero column is stored,
+* which for the cloth grid is bounded by the furthest connected particle
+*/
+class SparseCholesky
+{
+public:
+
+    /**
+    * Non-zero entry of the matrix
+    */
+    struct Entry
+    {
+        int row;       ///< Row of the entry
+        int column;    ///< Column of the entry
+        double value;  ///< Value added to the entry
+    };
+
+    /**
+    * Factorises the matrix, replacing any previous factorisation
+    * @param size The number of rows/columns of the matrix
+    * @param entries The entries of the lower triangle, duplicates are summed
+    * @return whether the matrix was positive definite
+    */
+    bool Factorise(int size, const std::vector<Entry>& entries);
+
+    /**
+    * Solves the factorised system in place for three right hand sides
+    * @param values The right hand side, replaced with the solution
+    */
+    void Solve(std::vector<D3DXVECTOR3>& values) const;
+
+    /**
+    * @return the number of rows/columns of the factorised matrix
+    */
+    int Size() const { return static_cast<int>(m_firstColumn.size()); }
+
+    /**
+    * @return the number of values stored for the factorisation
+    */
+    int GetStoredValues() const { return static_cast<int>(m_values.size()); }
+
+private:
+
+    std::vector<int> m_firstColumn;         ///< First stored column for each row
+    std::vector<int> m_rowStart;            ///< Offset of each row in the stored values
+    std::vector<double> m_values;           ///< Lower triangular factor stored row by row
+    mutable std::vector<double> m_solution; ///< Working space for solving the components
+};
@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - spatialhash.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "spatialhash.h"
+
+#include <cmath>
+
+namespace
+{
+    const unsigned int PRIME_X = 73856093u;  ///< Prime to hash the x cell coordinate
+    const unsigned int PRIME_Y = 19349663u;  ///< Prime to hash the y cell coordinate
+    const unsigned int PRIME_Z = 83492791u;  ///< Prime to hash the z cell coordinate
+}
+
+void SpatialHash::Build(const std::vector<D3DXVECTOR3>& positions, float cellSize)
+{
+    const int count = static_cast<int>(positions.size());
+    m_inverseCellSize = 1.0f / cellSize;
+
+    // Keep at least two buckets per point to limit cells sharing a bucket
+    unsigned int buckets = 1;
+    while(buckets < static_cast<unsigned int>(count * 2))
+    {
+        buckets <<= 1;
+    }
+    m_mask = buckets - 1;
+
+    // Count the points in each bucket and sum to find where each bucket ends
+    m_bucketStart.assign(buckets + 1, 0);
+    std::vector<Cell> pointCells(count);
+    std::vector<int> pointBuckets(count);
+    for(int i = 0; i < count; ++i)
+    {
+        Cell& cell = pointCells[i];
+        cell.x = GetCell(positions[i].x);
+        cell.y = GetCell(positions[i].y);
+        cell.z = GetCell(positions[i].z);
+        pointBuckets[i] = GetBucket(cell.x, cell.y, cell.z);
+        ++m_bucketStart[pointBuckets[i]];
+    }
+
+    for(unsigned int i = 1; i <= buckets; ++i)
+    {
+        m_bucketStart[i] += m_bucketStart[i-1];
+    }
+
+    // Fill each bucket from its end, leaving the offset at its start
+    m_entries.resize(count);
+    m_entryCells.resize(count);
+    for(int i = count-1; i >= 0; --i)
+    {
+        const int entry = --m_bucketStart[pointBuckets[i]];
+        m_entries[entry] = i;
+        m_entryCells[entry] = pointCells[i];
+    }
+}
+
+void SpatialHash::FindNeighbours(const D3DXVECTOR3& position, std::vector<int>& neighbours) const
+{
+    neighbours.clear();
+
+    const int cellX = GetCell(position.x);
+    const int cellY = GetCell(position.y);
+    const int cellZ = GetCell(position.z);
+
+    // Only take the points actually in each cell as different 
+    // cells can hash to the same bucket and be searched twice
+    for(int x = cellX-1; x <= cellX+1; ++x)
+    {
+        for(int y = cellY-1; y <= cellY+1; ++y)
+        {
+            for(int z = cellZ-1; z <= cellZ+1; ++z)
+            {
+                const int bucket = GetBucket(x, y, z);
+                const int end = m_bucketStart[bucket+1];
+                for(int i = m_bucketStart[bucket]; i < end; ++i)
+                {
+                    const Cell& cell = m_entryCells[i];
+                    if(cell.x == x && cell.y == y && cell.z == z)
+                    {
+                        neighbours.push_back(m_entries[i]);
+                    }
+                }
+            }
+        }
+    }
+}
+
+int SpatialHash::GetBucket(int x, int y, int z) const
+{
+    const unsigned int hash = (static_cast<unsigned int>(x) * PRIME_X) ^
+        (static_cast<unsigned int>(y) * PRIME_Y) ^ (static_cast<unsigned int>(z) * PRIME_Z);
+    return static_cast<int>(hash & m_mask);
+}
+
+int SpatialHash::GetCell(float value) const
+{
+    return static_cast<int>(std::floor(value * m_inverseCellSize));
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - spatialhash.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "directx.h"
+
+#include <vector>
+
+/**
+* Uniform grid of cells hashed into buckets for finding nearby points
+* Each build sorts the points by bucket so the points of a bucket are contiguous
+* and keeps the cell of each point so cells sharing a bucket can be told apart
+*/
+class SpatialHash
+{
+public:
+
+    /**
+    * Sorts the points into the buckets of the cells they lie in
+    * @param positions The points to hash
+    * @param cellSize The width of each cell, at least the largest distance searched
+    */
+    void Build(const std::vector<D3DXVECTOR3>& positions, float cellSize);
+
+    /**
+    * Finds all points in the cell of the position and the cells surrounding it
+    * @param position The position to search around
+    * @param neighbours Filled with the index of each point found
+    */
+    void FindNeighbours(const D3DXVECTOR3& position, std::vector<int>& neighbours) const;
+
+    /**
+    * @return the number of points hashed
+    */
+    int Size() const { return static_cast<int>(m_entries.size()); }
+
+private:
+
+    /**
+    * Coordinates of a cell in the grid
+    */
+    struct Cell
+    {
+        int x, y, z;
+    };
+
+    /**
+    * @param x/y/z The coordinates of the cell
+    * @return the bucket the cell hashes to
+    */
+    int GetBucket(int x, int y, int z) const;
+
+    /**
+    * @param value The world position along an axis
+    * @return the coordinate of the cell along the axis
+    */
+    int GetCell(float value) const;
+
+private:
+
+    float m_inverseCellSize = 1.0f;  ///< Inverse of the width of each cell
+    unsigned int m_mask = 0;         ///< Mask to wrap hashes to the bucket count
+    std::vector<int> m_bucketStart;  ///< Offset into the entries of each bucket
+    std::vector<int> m_entries;      ///< Index of each point sorted by bucket
+    std::vector<Cell> m_entryCells;  ///< Cell of each point sorted by bucket
+};
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springaccelerator.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "springaccelerator.h"
+#include "springstore.h"
+#include "particlestore.h"
+#include "threadpool.h"
+
+void SpringAccelerator::Solve(ParticleStore& particles,
+                              const SpringStore& springs,
+                              ThreadPool& threads,
+                              const SolverSettings& settings)
+{
+    Solve(particles, threads, settings, [&](float relaxation, SpringStore::Residual* residual)
+    {
+        springs.Solve(particles, threads, relaxation, residual);
+    });
+}
+
+void SpringAccelerator::Solve(ParticleStore& particles,
+                              ThreadPool& threads,
+                              const SolverSettings& settings,
+                              const IterationFn& iterate)
+{
+    const bool useChebyshev = settings.spectralRadius > 0.0f && settings.iterations > 2;
+    const float radiusSqr = settings.spectralRadius * settings.spectralRadius;
+    const bool measure = settings.stats != nullptr || settings.tolerance > 0.0f;
+    float omega = 1.0f;
+
+    for(int i = 0; i < settings.iterations; ++i)
+    {
+        if(useChebyshev)
+        {
+            m_older.swap(m_previous);
+            m_previous = particles.GetPositions();
+        }
+
+        SpringStore::Residual residual;
+        iterate(settings.relaxation, measure ? &residual : nullptr);
+        const float value = settings.useMaximumResidual ? residual.maximum : residual.rms;
+
+        if(settings.stats)
+        {
+            settings.stats->iterations = i + 1;
+            settings.stats->residual = value;
+            settings.stats->residuals.push_back(value);
+        }
+
+        if(settings.tolerance > 0.0f && 
+           value <= settings.tolerance && 
+           i + 1 >= settings.minimumIterations)
+        {
+            break;
+        }
+
+        // The first iteration has no prior iteration to weight with and the last
+        // is left unweighted so any overshoot does not carry into the velocity
+        if(useChebyshev && i > 0 && i < settings.iterations - 1)
+        {
+            omega = i == 1 ? 2.0f / (2.0f - radiusSqr) : 4.0f / (4.0f - (radiusSqr * omega));
+            Weight(particles, threads, omega);
+        }
+    }
+}
+
+void SpringAccelerator::Weight(ParticleStore& particles, ThreadPool& threads, float omega) const
+{
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+
+    threads.ParallelFor(particles.Size(), [&](int begin, int end)
+    {
+        for(int i = begin; i < end; ++i)
+        {
+            if(!(flags[i] & (ParticleStore::PINNED|ParticleStore::SLEEPING)))
+            {
+                positions[i] = m_older[i] + ((positions[i] - m_older[i]) * omega);
+            }
+        }
+    });
+}
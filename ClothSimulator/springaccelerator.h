@@ -0,0 +1,70 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springaccelerator.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springstore.h"
+#include "directx.h"
+
+#include <vector>
+#include <functional>
+
+/**
+* Runs the spring iterations of a tick with optional convergence acceleration
+* Each spring correction can be over-relaxed, and the positions after each
+* iteration can be weighted with the previous iterations using a chebyshev
+* semi-iterative method. The weighting is applied to the whole cloth between
+* iterations so does not depend on the order or threads used for the springs.
+* If a tolerance is given the iterations stop once the strain of the springs
+* measured as they are solved falls under it.
+*/
+class SpringAccelerator
+{
+public:
+
+    /**
+    * Solves a single iteration over all springs
+    * @param relaxation The over-relaxation of each spring correction
+    * @param residual The strain of the springs to fill or null if not needed
+    */
+    typedef std::function<void(float, SpringStore::Residual*)> IterationFn;
+
+    /**
+    * Solves the springs for up to the number of iterations in the settings
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    void Solve(ParticleStore& particles,
+               const SpringStore& springs,
+               ThreadPool& threads,
+               const SolverSettings& settings);
+
+    /**
+    * Runs the given spring iterations for up to the number in the settings
+    * @param particles The store holding the particle data
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    * @param iterate Solves a single iteration over all springs
+    */
+    void Solve(ParticleStore& particles,
+               ThreadPool& threads,
+               const SolverSettings& settings,
+               const IterationFn& iterate);
+
+private:
+
+    /**
+    * Weights the new positions with the positions from two iterations ago
+    * @param particles The store holding the particle data
+    * @param threads The threads to split the particles across
+    * @param omega The chebyshev weighting for the iteration
+    */
+    void Weight(ParticleStore& particles, ThreadPool& threads, float omega) const;
+
+    std::vector<D3DXVECTOR3> m_previous; ///< Positions before the last iteration
+    std::vector<D3DXVECTOR3> m_older;    ///< Positions before the iteration prior to the last
+};
@@ -0,0 +1,20 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "springsolver.h"
+#include "springstore.h"
+#include "particlestore.h"
+
+void SpringSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+}
+
+void SpringSolver::Solve(ParticleStore& particles,
+                         const SpringStore& springs,
+                         ThreadPool& threads,
+                         const SolverSettings& settings)
+{
+    m_accelerator.Solve(particles, springs, threads, settings);
+    particles.Integrate(settings.damping, settings.timestepSquared);
+}
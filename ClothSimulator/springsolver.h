@@ -0,0 +1,45 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springaccelerator.h"
+
+/**
+* Solves the springs by directly moving the particles towards their rest
+* length before integrating. Stiffness depends on the iterations and timestep.
+*/
+class SpringSolver : public ISolver
+{
+public:
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "Spring"; }
+
+private:
+
+    SpringAccelerator m_accelerator; ///< Runs the spring iterations
+};
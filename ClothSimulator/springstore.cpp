@@ -0,0 +1,292 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springstore.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "springstore.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "diagnostic.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <mutex>
+#include <assert.h>
+
+SpringStore::SpringStore()
+{
+    std::fill(std::begin(m_batches), std::end(m_batches), 0);
+}
+
+void SpringStore::Reset(int count)
+{
+    m_indices.clear();
+    m_restLength.clear();
+    m_type.clear();
+    m_batch.clear();
+
+    m_indices.reserve(count * 2);
+    m_restLength.reserve(count);
+    m_type.reserve(count);
+    m_batch.reserve(count);
+
+    std::fill(std::begin(m_batches), std::end(m_batches), 0);
+}
+
+void SpringStore::AddSpring(const std::vector<D3DXVECTOR3>& positions,
+                            std::uint32_t p1,
+                            std::uint32_t p2,
+                            Type type,
+                            int color)
+{
+    assert(color >= 0 && color < COLORS_PER_TYPE);
+
+    D3DXVECTOR3 difference = positions[p1]-positions[p2];
+    m_restLength.push_back(D3DXVec3Length(&difference));
+    m_indices.push_back(p1);
+    m_indices.push_back(p2);
+    m_type.push_back(static_cast<unsigned char>(type));
+    m_batch.push_back(static_cast<unsigned char>((type * COLORS_PER_TYPE) + color));
+}
+
+void SpringStore::CreateBatches()
+{
+    // Counting sort the springs by batch, keeping their relative order
+    std::fill(std::begin(m_batches), std::end(m_batches), 0);
+    for(unsigned char batch : m_batch)
+    {
+        ++m_batches[batch + 1];
+    }
+    for(int i = 0; i < MAX_BATCHES; ++i)
+    {
+        m_batches[i + 1] += m_batches[i];
+    }
+
+    std::vector<std::uint32_t> indices(m_indices.size());
+    std::vector<float> restLength(m_restLength.size());
+    std::vector<unsigned char> type(m_type.size());
+    std::vector<unsigned char> batch(m_batch.size());
+
+    int offsets[MAX_BATCHES];
+    std::copy(m_batches, m_batches + MAX_BATCHES, offsets);
+
+    for(int i = 0; i < Size(); ++i)
+    {
+        const int index = offsets[m_batch[i]]++;
+        indices[index*2] = m_indices[i*2];
+        indices[index*2+1] = m_indices[i*2+1];
+        restLength[index] = m_restLength[i];
+        type[index] = m_type[i];
+        batch[index] = m_batch[i];
+    }
+
+    m_indices.swap(indices);
+    m_restLength.swap(restLength);
+    m_type.swap(type);
+    m_batch.swap(batch);
+}
+
+void SpringStore::ScaleRestLengths(float scale)
+{
+    for(float& restLength : m_restLength)
+    {
+        restLength *= scale;
+    }
+}
+
+void SpringStore::CreateParticleBatches(int count, const std::vector<unsigned char>& colors)
+{
+    bool valid = static_cast<int>(colors.size()) == count;
+    for(int i = 0; valid && i < Size(); ++i)
+    {
+        valid = colors[m_indices[i*2]] != colors[m_indices[i*2+1]];
+    }
+
+    std::vector<unsigned char> greedyColors;
+    if(!valid)
+    {
+        ColorParticles(count, greedyColors);
+    }
+    const std::vector<unsigned char>& particleColors = valid ? colors : greedyColors;
+
+    // Counting sort the particles by color, keeping their relative order
+    int colorCount = 0;
+    for(unsigned char color : particleColors)
+    {
+        colorCount = max(colorCount, color + 1);
+    }
+
+    m_particleBatches.assign(colorCount + 1, 0);
+    for(unsigned char color : particleColors)
+    {
+        ++m_particleBatches[color + 1];
+    }
+    for(int i = 0; i < colorCount; ++i)
+    {
+        m_particleBatches[i + 1] += m_particleBatches[i];
+    }
+
+    std::vector<int> offsets(m_particleBatches.begin(), m_particleBatches.end() - 1);
+    m_particleOrder.resize(count);
+    for(int i = 0; i < count; ++i)
+    {
+        m_particleOrder[offsets[particleColors[i]]++] = i;
+    }
+}
+
+void SpringStore::ColorParticles(int count, std::vector<unsigned char>& colors) const
+{
+    const unsigned char NO_COLOR = 255;
+
+    // Gather the neighbours of each particle together
+    std::vector<int> offsets(count + 1, 0);
+    for(std::uint32_t index : m_indices)
+    {
+        ++offsets[index + 1];
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        offsets[i + 1] += offsets[i];
+    }
+
+    std::vector<std::uint32_t> neighbours(m_indices.size());
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+    for(int i = 0; i < Size(); ++i)
+    {
+        neighbours[next[m_indices[i*2]]++] = m_indices[i*2+1];
+        neighbours[next[m_indices[i*2+1]]++] = m_indices[i*2];
+    }
+
+    // Marks the colors used by the neighbours with the particle that is being colored
+    std::vector<int> used(NO_COLOR, -1);
+    colors.assign(count, NO_COLOR);
+
+    for(int i = 0; i < count; ++i)
+    {
+        for(int j = offsets[i]; j < offsets[i + 1]; ++j)
+        {
+            if(colors[neighbours[j]] != NO_COLOR)
+            {
+                used[colors[neighbours[j]]] = i;
+            }
+        }
+
+        int color = 0;
+        while(used[color] == i)
+        {
+            ++color;
+        }
+        assert(color < NO_COLOR);
+        colors[i] = static_cast<unsigned char>(color);
+    }
+}
+
+void SpringStore::Solve(ParticleStore& particles, 
+                        ThreadPool& threads, 
+                        float relaxation,
+                        Residual* residual) const
+{
+    std::mutex mutex;
+    float maximum = 0.0f;
+    double sumSquared = 0.0;
+
+    for(int i = 0; i < MAX_BATCHES; ++i)
+    {
+        const int begin = m_batches[i];
+        threads.ParallelFor(m_batches[i + 1] - begin, [&](int start, int end)
+        {
+            float chunkMaximum = 0.0f;
+            float chunkSumSquared = 0.0f;
+            SolveBatch(particles, begin + start, begin + end, relaxation,
+                residual != nullptr, chunkMaximum, chunkSumSquared);
+
+            if(residual)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                maximum = max(maximum, chunkMaximum);
+                sumSquared += chunkSumSquared;
+            }
+        });
+    }
+
+    if(residual)
+    {
+        residual->maximum = maximum;
+        residual->rms = Size() > 0 ? static_cast<float>(sqrt(sumSquared / Size())) : 0.0f;
+    }
+}
+
+void SpringStore::SolveBatch(ParticleStore& particles, 
+                             int begin, int end, 
+                             float relaxation,
+                             bool measure,
+                             float& maximum,
+                             float& sumSquared) const
+{
+    const std::vector<D3DXVECTOR3>& velocities = particles.GetInteractingVelocities();
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+
+    for(int i = begin; i < end; ++i)
+    {
+        const std::uint32_t p1 = m_indices[i*2];
+        const std::uint32_t p2 = m_indices[i*2+1];
+        if(flags[p1] & flags[p2] & ParticleStore::SLEEPING)
+        {
+            continue;
+        }
+        const D3DXVECTOR3& v1 = velocities[p1];
+        const D3DXVECTOR3& v2 = velocities[p2];
+
+        D3DXVECTOR3 difference(positions[p2] - positions[p1]);
+        float distance = D3DXVec3Length(&difference);
+        if(measure)
+        {
+            const float strain = fabs(distance - m_restLength[i]) / m_restLength[i];
+            maximum = max(maximum, strain);
+            sumSquared += strain * strain;
+        }
+
+        D3DXVECTOR3 error((difference-((difference/distance)*m_restLength[i])) * relaxation);
+
+        if(v1 != v2 && (!IsZeroVector(v1) || !IsZeroVector(v2)))
+        {
+            // Move the particle with the smallest amount of interacting
+            // velocity towards the particle with the most amount
+            const float v1Length = D3DXVec3LengthSq(&v1);
+            const float v2Length = D3DXVec3LengthSq(&v2);
+            particles.AdjustPosition(p2, -error * (v1Length > v2Length ? 0.9f : 0.1f));
+            particles.AdjustPosition(p1, error * (v1Length > v2Length ? 0.1f : 0.9f));
+        }
+        else
+        {
+            D3DXVECTOR3 errorHalf(error * 0.5f);
+            particles.AdjustPosition(p1, errorHalf);
+            particles.AdjustPosition(p2, -errorHalf);
+        }
+    }
+}
+
+void SpringStore::UpdateDiagnostic(Diagnostic& diagnostic, const ParticleStore& particles) const
+{
+    for(int i = 0; i < Size(); ++i)
+    {
+        const D3DXVECTOR3& p1 = particles.GetPosition(m_indices[i*2]);
+        const D3DXVECTOR3& p2 = particles.GetPosition(m_indices[i*2+1]);
+
+        switch(m_type[i])
+        {
+        case STRETCH:
+            diagnostic.UpdateLine(Diagnostic::CLOTH,
+                "Spring"+StringCast(i), Diagnostic::RED, p1, p2);
+            break;
+        case SHEAR:
+            diagnostic.UpdateLine(Diagnostic::CLOTH,
+                "Spring"+StringCast(i), Diagnostic::GREEN, p1, p2);
+            break;
+        case BEND:
+            diagnostic.UpdateSphere(Diagnostic::CLOTH, "Spring"+StringCast(i),
+                Diagnostic::YELLOW, (p1*0.5f)+(p2*0.5f), 0.1f);
+            break;
+        }
+    }
+}
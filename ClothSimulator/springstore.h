@@ -0,0 +1,209 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - springstore.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "directx.h"
+
+#include <vector>
+#include <cstdint>
+
+class ParticleStore;
+class ThreadPool;
+class Diagnostic;
+
+/**
+* Flat storage for all springs between cloth particles
+* Springs are grouped into batches of the same type and color so each
+* batch can be solved in a single tight loop over index pairs. No two
+* springs of the same batch share a particle, allowing the batch to be
+* split across threads. Particles are also grouped into colors where no
+* two particles of the same color are connected by a spring.
+*/
+class SpringStore
+{
+public:
+
+    /**
+    * Types of springs available
+    */
+    enum Type
+    {
+        STRETCH,
+        SHEAR,
+        BEND,
+        MAX_TYPES
+    };
+
+    /**
+    * Number of colors available to each type of spring
+    * The grid uses four while meshes need enough for their highest valence
+    */
+    static const int COLORS_PER_TYPE = 16;
+
+    /**
+    * Number of batches of independent springs
+    */
+    static const int MAX_BATCHES = MAX_TYPES * COLORS_PER_TYPE;
+
+    /**
+    * Constructor
+    */
+    SpringStore();
+
+    /**
+    * Removes all springs and reserves space for new ones
+    * @param count The expected number of springs
+    */
+    void Reset(int count);
+
+    /**
+    * Adds a spring using the current distance between particles as its rest length
+    * @param positions The positions of the particles
+    * @param p1/p2 The indices of the two particles connected by the spring
+    * @param type The type of spring created
+    * @param color The color of the spring, unique amongst springs of the
+    *        same type that share a particle and less than COLORS_PER_TYPE
+    */
+    void AddSpring(const std::vector<D3DXVECTOR3>& positions,
+                   std::uint32_t p1,
+                   std::uint32_t p2,
+                   Type type,
+                   int color);
+
+    /**
+    * Groups the added springs into batches by type and color
+    */
+    void CreateBatches();
+
+    /**
+    * Scales the rest length of all springs in place
+    * @param scale The amount to scale by
+    */
+    void ScaleRestLengths(float scale);
+
+    /**
+    * Groups the particles into batches that share no springs
+    * @param count The number of particles
+    * @param colors The color of each particle. If empty or if any spring
+    *        connects two particles of the same color, the particles are
+    *        colored greedily from the springs instead
+    */
+    void CreateParticleBatches(int count, const std::vector<unsigned char>& colors);
+
+    /**
+    * Strain of the springs measured as they are solved
+    */
+    struct Residual
+    {
+        float maximum = 0.0f;  ///< Largest strain of any spring
+        float rms = 0.0f;      ///< Root mean square strain of all springs
+    };
+
+    /**
+    * Solves all springs one batch at a time
+    * @param particles The store holding the particle data
+    * @param threads The threads to split each batch across
+    * @param relaxation The amount to scale each spring correction by
+    * @param residual If not null, receives the strain of the springs before each was corrected
+    */
+    void Solve(ParticleStore& particles, 
+               ThreadPool& threads, 
+               float relaxation = 1.0f,
+               Residual* residual = nullptr) const;
+
+    /**
+    * Updates the line diagnostic for the springs
+    * @param diagnostic The diagnostic renderer
+    * @param particles The store holding the particle data
+    */
+    void UpdateDiagnostic(Diagnostic& diagnostic, const ParticleStore& particles) const;
+
+    /**
+    * @return the number of springs held
+    */
+    int Size() const { return static_cast<int>(m_restLength.size()); }
+
+    /**
+    * @param batch The batch of springs to query
+    * @return the index of the first spring in the batch
+    */
+    int GetBatchBegin(int batch) const { return m_batches[batch]; }
+
+    /**
+    * @param batch The batch of springs to query
+    * @return the index after the last spring in the batch
+    */
+    int GetBatchEnd(int batch) const { return m_batches[batch + 1]; }
+
+    /**
+    * @return the pairs of particle indices connected by each spring
+    */
+    const std::vector<std::uint32_t>& GetIndices() const { return m_indices; }
+
+    /**
+    * @return the distance for each spring at rest
+    */
+    const std::vector<float>& GetRestLengths() const { return m_restLength; }
+
+    /**
+    * @return the type of each spring
+    */
+    const std::vector<unsigned char>& GetTypes() const { return m_type; }
+
+    /**
+    * @return the number of batches of independent particles
+    */
+    int GetParticleBatches() const { return static_cast<int>(m_particleBatches.size()) - 1; }
+
+    /**
+    * @param batch The batch of particles to query
+    * @return the offset of the first particle of the batch in the particle order
+    */
+    int GetParticleBatchBegin(int batch) const { return m_particleBatches[batch]; }
+
+    /**
+    * @param batch The batch of particles to query
+    * @return the offset after the last particle of the batch in the particle order
+    */
+    int GetParticleBatchEnd(int batch) const { return m_particleBatches[batch + 1]; }
+
+    /**
+    * @return the particle indices sorted by batch
+    */
+    const std::vector<std::uint32_t>& GetParticleOrder() const { return m_particleOrder; }
+
+private:
+
+    /**
+    * Solves a single batch of springs
+    * @param particles The store holding the particle data
+    * @param begin/end The range of springs in the batch
+    * @param relaxation The amount to scale each spring correction by
+    * @param measure Whether to measure the strain of the springs
+    * @param maximum Receives the largest strain of the springs
+    * @param sumSquared Receives the sum of the squared strain of the springs
+    */
+    void SolveBatch(ParticleStore& particles, 
+                    int begin, int end, 
+                    float relaxation,
+                    bool measure,
+                    float& maximum,
+                    float& sumSquared) const;
+
+    /**
+    * Colors each particle with the lowest color not used by its neighbours
+    * @param count The number of particles
+    * @param colors The color of each particle
+    */
+    void ColorParticles(int count, std::vector<unsigned char>& colors) const;
+
+    std::vector<std::uint32_t> m_indices;       ///< Pairs of connected particle indices
+    std::vector<float> m_restLength;            ///< Distance for each spring at rest
+    std::vector<unsigned char> m_type;          ///< Type of each spring
+    std::vector<unsigned char> m_batch;         ///< Batch of each spring from its type and color
+    int m_batches[MAX_BATCHES + 1];             ///< Offsets of each batch of springs
+    std::vector<int> m_particleBatches;         ///< Offsets of each batch of particles
+    std::vector<std::uint32_t> m_particleOrder; ///< Particle indices sorted by batch
+};
@@ -0,0 +1,221 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - stencilsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "stencilsolver.h"
+#include "springstore.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <mutex>
+
+namespace
+{
+    /**
+    * Springs joining each particle to a single neighbour offset
+    */
+    struct Stencil
+    {
+        float restScale; ///< Rest length of the spring in grid spacings
+        int offsetX;     ///< Column offset of the neighbour
+        int offsetY;     ///< Row offset of the neighbour
+        bool alongRow;   ///< Whether the color alternates along each row or down the columns
+        int period;      ///< Neighbouring rows or columns that share a color
+    };
+
+    /**
+    * Neighbour offsets of the grid in the order of the spring batches
+    * Each stencil covers two colors of its spring type
+    */
+    const Stencil STENCILS[] =
+    {
+        { 1.0f,          1, 0, true,  1 },  // Stretch along the rows
+        { 1.0f,          0, 1, false, 1 },  // Stretch down the columns
+        { 1.414213562f,  1, 1, true,  1 },  // Shear to the right
+        { 1.414213562f, -1, 1, true,  1 },  // Shear to the left
+        { 2.0f,          2, 0, true,  2 },  // Bend along the rows
+        { 2.0f,          0, 2, false, 2 }   // Bend down the columns
+    };
+
+    /**
+    * Solves the rows of a single color of a stencil
+    * No two springs of the same color share a particle so rows can be split across
+    * threads. Each spring is corrected the same as a single spring of the spring store.
+    * @param particles The store holding the particle data
+    * @param stencil The neighbour offset to solve
+    * @param color The color of the springs to solve
+    * @param restLength The distance for each spring at rest
+    * @param relaxation The over-relaxation of each spring correction
+    * @param begin/end The range of rows to solve
+    * @param measure Whether to measure the strain of the springs
+    * @param maximum The largest strain to update
+    * @param sumSquared The sum of the squared strains to add to
+    */
+    void SolveRows(ParticleStore& particles,
+                   const Stencil& stencil,
+                   int color,
+                   float restLength,
+                   float relaxation,
+                   int begin, int end,
+                   bool measure,
+                   float& maximum,
+                   float& sumSquared)
+    {
+        D3DXVECTOR3* positions = &particles.GetPositions()[0];
+        const D3DXVECTOR3* velocities = &particles.GetInteractingVelocities()[0];
+        const unsigned char* flags = &particles.GetFlags()[0];
+        const unsigned char immovable = ParticleStore::PINNED|ParticleStore::SLEEPING;
+
+        const int length = particles.GetGridLength();
+        const int period = stencil.period;
+        const int neighbour = (stencil.offsetY * length) + stencil.offsetX;
+        const int beginX = max(0, -stencil.offsetX);
+        const int endX = length - max(0, stencil.offsetX);
+
+        // Colors alternating along the row are solved as a strided run for each column
+        // of the period, otherwise every column of the rows with the color are solved
+        const int runs = stencil.alongRow ? period : 1;
+        const int stride = stencil.alongRow ? period * 2 : 1;
+        float rowMaximum = 0.0f;
+        float rowSumSquared = 0.0f;
+
+        for(int y = begin; y < end; ++y)
+        {
+            if(!stencil.alongRow && ((y / period) % 2) != color)
+            {
+                continue;
+            }
+
+            const int row = y * length;
+            for(int run = 0; run < runs; ++run)
+            {
+                int column = stencil.alongRow ? (color * period) + run : beginX;
+                if(column < beginX)
+                {
+                    column += stride;
+                }
+
+                for(; column < endX; column += stride)
+                {
+                    const int p1 = row + column;
+                    const int p2 = p1 + neighbour;
+                    if(flags[p1] & flags[p2] & ParticleStore::SLEEPING)
+                    {
+                        continue;
+                    }
+
+                    D3DXVECTOR3 difference(positions[p2] - positions[p1]);
+                    const float distance = D3DXVec3Length(&difference);
+                    if(measure)
+                    {
+                        const float strain = fabs(distance - restLength) / restLength;
+                        rowMaximum = max(rowMaximum, strain);
+                        rowSumSquared += strain * strain;
+                    }
+
+                    const D3DXVECTOR3 error((difference-((difference/distance)*restLength)) * relaxation);
+
+                    // Move the particle with the smallest amount of interacting
+                    // velocity towards the particle with the most amount
+                    float weight1 = 0.5f;
+                    float weight2 = 0.5f;
+                    const D3DXVECTOR3& v1 = velocities[p1];
+                    const D3DXVECTOR3& v2 = velocities[p2];
+                    if(v1 != v2 && (!IsZeroVector(v1) || !IsZeroVector(v2)))
+                    {
+                        const bool firstFaster = D3DXVec3LengthSq(&v1) > D3DXVec3LengthSq(&v2);
+                        weight1 = firstFaster ? 0.1f : 0.9f;
+                        weight2 = firstFaster ? 0.9f : 0.1f;
+                    }
+
+                    if(!(flags[p1] & immovable))
+                    {
+                        positions[p1] += error * weight1;
+                    }
+                    if(!(flags[p2] & immovable))
+                    {
+                        positions[p2] -= error * weight2;
+                    }
+                }
+            }
+        }
+
+        maximum = max(maximum, rowMaximum);
+        sumSquared += rowSumSquared;
+    }
+}
+
+void StencilSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    const int length = particles.GetGridLength();
+    m_springCount = 0;
+    for(const Stencil& stencil : STENCILS)
+    {
+        m_springCount += max(length - abs(stencil.offsetX), 0) *
+            max(length - stencil.offsetY, 0);
+    }
+}
+
+void StencilSolver::Solve(ParticleStore& particles,
+                          const SpringStore& springs,
+                          ThreadPool& threads,
+                          const SolverSettings& settings)
+{
+    if(particles.GetGridLength() == 0 || particles.GetGridSpacing() <= 0.0f)
+    {
+        m_accelerator.Solve(particles, springs, threads, settings);
+    }
+    else
+    {
+        m_accelerator.Solve(particles, threads, settings,
+            [&](float relaxation, SpringStore::Residual* residual)
+        {
+            SolveIteration(particles, threads, relaxation, residual);
+        });
+    }
+
+    particles.Integrate(settings.damping, settings.timestepSquared);
+}
+
+void StencilSolver::SolveIteration(ParticleStore& particles,
+                                   ThreadPool& threads,
+                                   float relaxation,
+                                   SpringStore::Residual* residual) const
+{
+    std::mutex mutex;
+    float maximum = 0.0f;
+    double sumSquared = 0.0;
+
+    const int length = particles.GetGridLength();
+    const float spacing = particles.GetGridSpacing();
+
+    for(const Stencil& stencil : STENCILS)
+    {
+        const float restLength = spacing * stencil.restScale;
+        for(int color = 0; color < 2; ++color)
+        {
+            threads.ParallelFor(length - stencil.offsetY, [&](int begin, int end)
+            {
+                float chunkMaximum = 0.0f;
+                float chunkSumSquared = 0.0f;
+                SolveRows(particles, stencil, color, restLength, relaxation,
+                    begin, end, residual != nullptr, chunkMaximum, chunkSumSquared);
+
+                if(residual)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    maximum = max(maximum, chunkMaximum);
+                    sumSquared += chunkSumSquared;
+                }
+            });
+        }
+    }
+
+    if(residual)
+    {
+        residual->maximum = maximum;
+        residual->rms = m_springCount > 0 ?
+            static_cast<float>(sqrt(sumSquared / m_springCount)) : 0.0f;
+    }
+}
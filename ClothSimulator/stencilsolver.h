@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - stencilsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springaccelerator.h"
+
+/**
+* Spring solver for grid cloths that stores no springs
+* Every spring of the grid joins a particle to a fixed neighbour offset, so each
+* type and color of spring is solved as a sweep over the rows of the position
+* array with rest lengths taken from the grid spacing. The sweeps run in the same
+* order as the batches of the spring store, giving the same result as the spring
+* solver without streaming the spring indices and rest lengths each iteration.
+* Cloths that are not a grid fall back to the stored springs.
+*/
+class StencilSolver : public ISolver
+{
+public:
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "Stencil"; }
+
+private:
+
+    /**
+    * Solves a single iteration over all springs of the grid
+    * @param particles The store holding the particle data
+    * @param threads The threads to split the rows across
+    * @param relaxation The over-relaxation of each spring correction
+    * @param residual The strain of the springs to fill or null if not needed
+    */
+    void SolveIteration(ParticleStore& particles,
+                        ThreadPool& threads,
+                        float relaxation,
+                        SpringStore::Residual* residual) const;
+
+    SpringAccelerator m_accelerator; ///< Runs the spring iterations
+    int m_springCount = 0;           ///< Number of springs in the grid
+};
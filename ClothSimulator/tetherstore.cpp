@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - tetherstore.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "tetherstore.h"
+#include "particlestore.h"
+#include "springstore.h"
+#include "threadpool.h"
+
+#include <algorithm>
+#include <queue>
+#include <limits>
+
+namespace
+{
+    const float UNREACHABLE = std::numeric_limits<float>::max(); ///< Distance to particles not connected to a pin
+}
+
+void TetherStore::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    const int count = particles.Size();
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const std::vector<float>& restLength = springs.GetRestLengths();
+
+    // Build the spring graph with each particle's neighbours stored together
+    m_edgeOffsets.assign(count + 1, 0);
+    for(std::uint32_t index : indices)
+    {
+        ++m_edgeOffsets[index + 1];
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        m_edgeOffsets[i + 1] += m_edgeOffsets[i];
+    }
+
+    m_edges.resize(indices.size());
+    m_edgeLength.resize(indices.size());
+    std::vector<int> offsets(m_edgeOffsets.begin(), m_edgeOffsets.end() - 1);
+
+    for(int i = 0; i < springs.Size(); ++i)
+    {
+        const std::uint32_t p1 = indices[i*2];
+        const std::uint32_t p2 = indices[i*2+1];
+        m_edges[offsets[p1]] = p2;
+        m_edgeLength[offsets[p1]++] = restLength[i];
+        m_edges[offsets[p2]] = p1;
+        m_edgeLength[offsets[p2]++] = restLength[i];
+    }
+
+    m_pins.resize(count * MAX_TETHERS);
+    m_restLength.resize(count * MAX_TETHERS);
+    m_count.resize(count);
+    RemoveAllPins();
+
+    for(int i = 0; i < count; ++i)
+    {
+        if(particles.HasFlag(i, ParticleStore::PINNED))
+        {
+            AddPin(i);
+        }
+    }
+}
+
+void TetherStore::AddPin(int index)
+{
+    std::vector<float>& distances = m_distances[index];
+    CalculateDistances(index, distances);
+
+    const int count = static_cast<int>(m_count.size());
+    for(int i = 0; i < count; ++i)
+    {
+        if(i != index && distances[i] != UNREACHABLE)
+        {
+            InsertTether(i, index, distances[i]);
+        }
+    }
+}
+
+void TetherStore::RemovePin(int index)
+{
+    if(m_distances.erase(index) == 0)
+    {
+        return;
+    }
+
+    // Only particles tethered to the pin need to search the remaining pins
+    const int count = static_cast<int>(m_count.size());
+    for(int i = 0; i < count; ++i)
+    {
+        const std::uint32_t* pins = &m_pins[i * MAX_TETHERS];
+        if(std::find(pins, pins + m_count[i], static_cast<std::uint32_t>(index)) != pins + m_count[i])
+        {
+            RebuildTethers(i);
+        }
+    }
+}
+
+void TetherStore::RemoveAllPins()
+{
+    m_distances.clear();
+    std::fill(m_count.begin(), m_count.end(), 0);
+    m_tetherCount = 0;
+}
+
+void TetherStore::CalculateDistances(int pin, std::vector<float>& distances) const
+{
+    typedef std::pair<float, std::uint32_t> Node;
+    std::priority_queue<Node, std::vector<Node>, std::greater<Node>> open;
+
+    distances.assign(m_count.size(), UNREACHABLE);
+    distances[pin] = 0.0f;
+    open.push(Node(0.0f, pin));
+
+    while(!open.empty())
+    {
+        const Node node = open.top();
+        open.pop();
+
+        if(node.first > distances[node.second])
+        {
+            continue;
+        }
+
+        for(int i = m_edgeOffsets[node.second]; i < m_edgeOffsets[node.second + 1]; ++i)
+        {
+            const float distance = node.first + m_edgeLength[i];
+            if(distance < distances[m_edges[i]])
+            {
+                distances[m_edges[i]] = distance;
+                open.push(Node(distance, m_edges[i]));
+            }
+        }
+    }
+}
+
+void TetherStore::InsertTether(int index, int pin, float distance)
+{
+    // Tethers are kept sorted from the nearest pin
+    std::uint32_t* pins = &m_pins[index * MAX_TETHERS];
+    float* restLength = &m_restLength[index * MAX_TETHERS];
+    int position = m_count[index];
+
+    if(position == MAX_TETHERS)
+    {
+        if(distance >= restLength[MAX_TETHERS - 1])
+        {
+            return;
+        }
+        --position;
+    }
+    else
+    {
+        ++m_count[index];
+        ++m_tetherCount;
+    }
+
+    for(; position > 0 && restLength[position - 1] > distance; --position)
+    {
+        pins[position] = pins[position - 1];
+        restLength[position] = restLength[position - 1];
+    }
+    pins[position] = pin;
+    restLength[position] = distance;
+}
+
+void TetherStore::RebuildTethers(int index)
+{
+    m_tetherCount -= m_count[index];
+    m_count[index] = 0;
+
+    for(const auto& pin : m_distances)
+    {
+        if(pin.first != index && pin.second[index] != UNREACHABLE)
+        {
+            InsertTether(index, pin.first, pin.second[index]);
+        }
+    }
+}
+
+void TetherStore::Solve(ParticleStore& particles, ThreadPool& threads) const
+{
+    if(m_tetherCount == 0)
+    {
+        return;
+    }
+
+    // Each particle only moves itself towards its pins
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+
+    threads.ParallelFor(static_cast<int>(m_count.size()), [&](int begin, int end)
+    {
+        for(int i = begin; i < end; ++i)
+        {
+            if(flags[i] & (ParticleStore::PINNED|ParticleStore::SLEEPING))
+            {
+                continue;
+            }
+
+            D3DXVECTOR3& position = positions[i];
+            for(int j = i * MAX_TETHERS; j < (i * MAX_TETHERS) + m_count[i]; ++j)
+            {
+                const D3DXVECTOR3& pin = positions[m_pins[j]];
+                D3DXVECTOR3 difference(position - pin);
+                const float length = D3DXVec3Length(&difference);
+                if(length > m_restLength[j])
+                {
+                    position = pin + (difference * (m_restLength[j] / length));
+                }
+            }
+        }
+    });
+}
@@ -0,0 +1,97 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - tetherstore.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <cstdint>
+
+class ParticleStore;
+class SpringStore;
+class ThreadPool;
+
+/**
+* Long range attachments from each free particle to its nearest pinned particles
+* A tether only acts when the particle is further from its pin than the
+* shortest path between them along the springs, preventing the cloth
+* from stretching away from the pins regardless of solver iterations
+*/
+class TetherStore
+{
+public:
+
+    /**
+    * Maximum number of pins each particle is tethered to
+    */
+    static const int MAX_TETHERS = 4;
+
+    /**
+    * Recreates the spring graph and tethers all currently pinned particles
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    void Initialise(const ParticleStore& particles, const SpringStore& springs);
+
+    /**
+    * Tethers particles to a newly pinned particle if it is one of their nearest
+    * @param index The index of the pinned particle
+    */
+    void AddPin(int index);
+
+    /**
+    * Removes any tethers to a particle that is no longer pinned
+    * @param index The index of the unpinned particle
+    */
+    void RemovePin(int index);
+
+    /**
+    * Removes all tethers
+    */
+    void RemoveAllPins();
+
+    /**
+    * Moves any particles that have moved past their tether lengths
+    * @param particles The store holding the particle data
+    * @param threads The threads to split the particles across
+    */
+    void Solve(ParticleStore& particles, ThreadPool& threads) const;
+
+    /**
+    * @return the number of tethers held
+    */
+    int Size() const { return m_tetherCount; }
+
+private:
+
+    /**
+    * Calculates the shortest path along the springs from the pin to all particles
+    * @param pin The index of the pinned particle
+    * @param distances The distance to each particle
+    */
+    void CalculateDistances(int pin, std::vector<float>& distances) const;
+
+    /**
+    * Adds a tether if the pin is one of the nearest to the particle
+    * @param index The index of the particle to tether
+    * @param pin The index of the pinned particle
+    * @param distance The shortest path between the particle and pin
+    */
+    void InsertTether(int index, int pin, float distance);
+
+    /**
+    * Recreates the tethers for a particle from all cached pin distances
+    * @param index The index of the particle to tether
+    */
+    void RebuildTethers(int index);
+
+    std::vector<int> m_edgeOffsets;                    ///< Offsets of each particle's neighbours
+    std::vector<std::uint32_t> m_edges;                ///< Neighbouring particles connected by a spring
+    std::vector<float> m_edgeLength;                   ///< Rest length of the spring to each neighbour
+    std::map<int, std::vector<float>> m_distances;     ///< Shortest path to all particles for each pin
+    std::vector<std::uint32_t> m_pins;                 ///< Nearest pins for each particle
+    std::vector<float> m_restLength;                   ///< Maximum length for each tether
+    std::vector<unsigned char> m_count;                ///< Number of tethers for each particle
+    int m_tetherCount = 0;                             ///< Overall number of tethers
+};
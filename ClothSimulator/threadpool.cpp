@@ -0,0 +1,116 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - threadpool.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads)
+{
+    SetThreadCount(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+    StopWorkers();
+}
+
+void ThreadPool::SetThreadCount(int threads)
+{
+    StopWorkers();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_exit = false;
+    const int workers = std::max(threads, 1) - 1;
+    for(int i = 0; i < workers; ++i)
+    {
+        m_workers.push_back(std::thread(&ThreadPool::WorkerLoop, this, i, m_generation));
+    }
+}
+
+int ThreadPool::GetThreadCount() const
+{
+    return static_cast<int>(m_workers.size()) + 1;
+}
+
+int ThreadPool::GetMaxThreads()
+{
+    return std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+}
+
+void ThreadPool::StopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_exit = true;
+    }
+    m_start.notify_all();
+
+    for(std::thread& worker : m_workers)
+    {
+        worker.join();
+    }
+    m_workers.clear();
+}
+
+void ThreadPool::ParallelFor(int count, const RangeFn& fn)
+{
+    const int chunks = std::min(GetThreadCount(), count);
+    if(chunks <= 1)
+    {
+        fn(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &fn;
+        m_count = count;
+        m_chunks = chunks;
+        m_remaining = chunks - 1;
+        ++m_generation;
+    }
+    m_start.notify_all();
+
+    // The calling thread runs the first chunk
+    fn(0, count / chunks);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [this](){ return m_remaining == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::WorkerLoop(int index, unsigned int generation)
+{
+    const int chunk = index + 1;
+    while(true)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_start.wait(lock, [&](){ return m_exit || m_generation != generation; });
+        if(m_exit)
+        {
+            return;
+        }
+
+        // Workers past the end of a short range sit this job out
+        generation = m_generation;
+        if(chunk >= m_chunks)
+        {
+            continue;
+        }
+
+        const RangeFn& job = *m_job;
+        const int begin = (m_count * chunk) / m_chunks;
+        const int end = (m_count * (chunk + 1)) / m_chunks;
+        lock.unlock();
+
+        job(begin, end);
+
+        lock.lock();
+        if(--m_remaining == 0)
+        {
+            m_done.notify_one();
+        }
+    }
+}
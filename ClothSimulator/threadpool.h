@@ -0,0 +1,89 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - threadpool.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+* Pool of worker threads for splitting loops across cores
+*/
+class ThreadPool
+{
+public:
+
+    typedef std::function<void(int begin, int end)> RangeFn;
+
+    /**
+    * Constructor
+    * @param threads The number of threads including the calling thread
+    */
+    explicit ThreadPool(int threads);
+
+    /**
+    * Destructor
+    */
+    ~ThreadPool();
+
+    /**
+    * Sets the number of threads used, recreating the workers
+    * @param threads The number of threads including the calling thread
+    */
+    void SetThreadCount(int threads);
+
+    /**
+    * @return the number of threads including the calling thread
+    */
+    int GetThreadCount() const;
+
+    /**
+    * @return the number of hardware threads available
+    */
+    static int GetMaxThreads();
+
+    /**
+    * Splits the range into a chunk for each thread and blocks until all are done
+    * Ranges shorter than the thread count give each item its own thread
+    * @param count The number of items in the range
+    * @param fn The function to call for each chunk
+    */
+    void ParallelFor(int count, const RangeFn& fn);
+
+private:
+
+    /**
+    * Waits for and runs chunks on a worker thread
+    * @param index The index of the worker
+    * @param generation The job generation when the worker was created
+    */
+    void WorkerLoop(int index, unsigned int generation);
+
+    /**
+    * Stops and joins all worker threads
+    */
+    void StopWorkers();
+
+    /**
+    * Prevent copying
+    */
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+private:
+
+    std::vector<std::thread> m_workers;   ///< Worker threads excluding the calling thread
+    std::mutex m_mutex;                   ///< Guards the job state
+    std::condition_variable m_start;      ///< Signals the workers a job is ready
+    std::condition_variable m_done;       ///< Signals the caller all workers are finished
+    const RangeFn* m_job = nullptr;       ///< Current job being run
+    int m_count = 0;                      ///< Number of items in the current job
+    int m_chunks = 0;                     ///< Number of threads the current job is split across
+    int m_remaining = 0;                  ///< Number of workers still running the job
+    unsigned int m_generation = 0;        ///< Incremented for each new job
+    bool m_exit = false;                  ///< Whether the workers should exit
+};
@@ -9,15 +9,18 @@
 
 namespace
 {
-    const double DT_INCREASE = 0.001; ///< Amount to change the forced deltatime
-    const double DT_MAXIMUM = 0.03;   ///< Maximum allowed deltatime
-    const double DT_MINIMUM = 0.01;   ///< Minimum allowed deltatime
+    const double DT_INCREASE = 0.001;   ///< Amount to change the forced deltatime
+    const double DT_MAXIMUM = 0.03;     ///< Maximum allowed deltatime
+    const double DT_MINIMUM = 0.01;     ///< Minimum allowed deltatime
+    const double NS_PER_SECOND = 1.0e9; ///< Nanoseconds in a second
+    const double AVERAGE_WEIGHT = 0.1;  ///< Weighting of new samples for profiling averages
 }
 
 Timer::Timer(EnginePtr engine)
     : m_frequency(0.0)
     , m_previousTime(0.0)
     , m_deltaTime(0.0)
+    , m_frameTime(0.0)
     , m_deltaTimeCounter(0.0)
     , m_fps(0)
     , m_fpsCounter(0)
@@ -51,6 +54,7 @@ void Timer::UpdateTimer()
         m_fpsCounter = 0;
     }
 
+    m_frameTime = deltatime;
     m_deltaTime = max(deltatime, DT_MINIMUM);
     m_deltaTime = min(m_deltaTime, DT_MAXIMUM);
 
@@ -82,6 +86,11 @@ float Timer::GetDeltaTime() const
     return static_cast<float>(m_forceDeltatime ? m_forcedDeltatime : m_deltaTime); 
 }
 
+float Timer::GetFrameTime() const 
+{ 
+    return static_cast<float>(m_forceDeltatime ? m_forcedDeltatime : m_frameTime); 
+}
+
 void Timer::ToggleForceDeltatime()
 {
     m_forceDeltatime = !m_forceDeltatime;
@@ -90,4 +99,48 @@ void Timer::ToggleForceDeltatime()
 void Timer::ChangeDeltatime(bool increase)
 {
     m_forcedDeltatime += increase ? DT_INCREASE : -DT_INCREASE;
+}
+
+Stopwatch::Stopwatch()
+    : m_frequency(0.0)
+    , m_averageTime(0.0)
+    , m_lastTime(0.0)
+{
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    m_frequency = static_cast<double>(frequency.QuadPart);
+    m_start.QuadPart = 0;
+}
+
+void Stopwatch::Start()
+{
+    QueryPerformanceCounter(&m_start);
+}
+
+void Stopwatch::Stop()
+{
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+
+    const double elapsed = static_cast<double>(end.QuadPart - m_start.QuadPart) 
+        / m_frequency * NS_PER_SECOND;
+
+    m_lastTime = elapsed;
+    m_averageTime = m_averageTime == 0.0 ? elapsed :
+        (m_averageTime * (1.0 - AVERAGE_WEIGHT)) + (elapsed * AVERAGE_WEIGHT);
+}
+
+void Stopwatch::Reset()
+{
+    m_averageTime = 0.0;
+}
+
+double Stopwatch::GetAverageTime() const
+{
+    return m_averageTime;
+}
+
+double Stopwatch::GetLastTime() const
+{
+    return m_lastTime;
 }
\ No newline at end of file
@@ -35,6 +35,11 @@ public:
     */
     float GetDeltaTime() const;
 
+    /**
+    * @return The unclamped time passed since last frame in seconds
+    */
+    float GetFrameTime() const;
+
     /**
     * Toggles whether to use an explicitly set deltatime
     */
@@ -53,6 +58,7 @@ private:
     LARGE_INTEGER m_timer;      ///< The current time queried
     double m_previousTime;      ///< The previous time queried
     double m_deltaTime;         ///< The time passed since last frame in seconds
+    double m_frameTime;         ///< The unclamped time passed since last frame in seconds
     double m_deltaTimeCounter;  ///< Combined timestep between frames up to 1 second
     unsigned int m_fps;         ///< Amount of frames rendered in 1 second
     unsigned int m_fpsCounter;  ///< Amount of frames rendered since delta time counter began
@@ -60,3 +66,47 @@ private:
     double m_forcedDeltatime;   ///< The value for the forced deltatime
 };
 
+/**
+* High-resolution stopwatch for profiling sections of a frame
+*/
+class Stopwatch
+{
+public:
+
+    /**
+    * Constructor
+    */
+    Stopwatch();
+
+    /**
+    * Starts timing a section
+    */
+    void Start();
+
+    /**
+    * Stops timing a section and adds it to the running average
+    */
+    void Stop();
+
+    /**
+    * Clears the running average
+    */
+    void Reset();
+
+    /**
+    * @return the smoothed time taken for the section in nanoseconds
+    */
+    double GetAverageTime() const;
+
+    /**
+    * @return the time taken for the section when last stopped in nanoseconds
+    */
+    double GetLastTime() const;
+
+private:
+
+    double m_frequency;     ///< The frequency of the high-resolution performance counter
+    LARGE_INTEGER m_start;  ///< The time queried when the section started
+    double m_averageTime;   ///< Smoothed time taken for the section in nanoseconds
+    double m_lastTime;      ///< Time taken for the section when last stopped in nanoseconds
+};
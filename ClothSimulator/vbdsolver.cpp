@@ -0,0 +1,181 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - vbdsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "vbdsolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "utils.h"
+
+namespace
+{
+    const float STRETCH_STIFFNESS = 100.0f;  ///< Initial spring constant for stretch springs
+    const float SHEAR_STIFFNESS = 20.0f;     ///< Initial spring constant for shear springs
+    const float BEND_STIFFNESS = 2.0f;       ///< Initial spring constant for bending springs
+    const float MINIMUM_DETERMINANT = 1e-8f; ///< Smallest determinant of the hessian to solve
+}
+
+VbdSolver::VbdSolver()
+{
+    m_stiffness[SpringStore::STRETCH] = STRETCH_STIFFNESS;
+    m_stiffness[SpringStore::SHEAR] = SHEAR_STIFFNESS;
+    m_stiffness[SpringStore::BEND] = BEND_STIFFNESS;
+}
+
+void VbdSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    const int count = particles.Size();
+    const std::vector<std::uint32_t>& order = springs.GetParticleOrder();
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const std::vector<float>& restLength = springs.GetRestLengths();
+    const std::vector<unsigned char>& types = springs.GetTypes();
+
+    // Neighbours are stored in batch order so each batch reads them contiguously
+    std::vector<int> position(count);
+    for(int i = 0; i < static_cast<int>(order.size()); ++i)
+    {
+        position[order[i]] = i;
+    }
+
+    m_edgeOffsets.assign(count + 1, 0);
+    for(std::uint32_t index : indices)
+    {
+        ++m_edgeOffsets[position[index] + 1];
+    }
+    for(int i = 0; i < count; ++i)
+    {
+        m_edgeOffsets[i + 1] += m_edgeOffsets[i];
+    }
+
+    m_edges.resize(indices.size());
+    m_edgeLength.resize(indices.size());
+    m_edgeType.resize(indices.size());
+    std::vector<int> offsets(m_edgeOffsets.begin(), m_edgeOffsets.end() - 1);
+
+    for(int i = 0; i < springs.Size(); ++i)
+    {
+        const std::uint32_t p1 = indices[i*2];
+        const std::uint32_t p2 = indices[i*2+1];
+
+        int& edge1 = offsets[position[p1]];
+        m_edges[edge1] = p2;
+        m_edgeLength[edge1] = restLength[i];
+        m_edgeType[edge1++] = types[i];
+
+        int& edge2 = offsets[position[p2]];
+        m_edges[edge2] = p1;
+        m_edgeLength[edge2] = restLength[i];
+        m_edgeType[edge2++] = types[i];
+    }
+
+    m_inertia.resize(count);
+}
+
+void VbdSolver::Solve(ParticleStore& particles,
+                      const SpringStore& springs,
+                      ThreadPool& threads,
+                      const SolverSettings& settings)
+{
+    if(static_cast<int>(m_edges.size()) != springs.Size() * 2 ||
+       static_cast<int>(m_inertia.size()) != particles.Size())
+    {
+        Initialise(particles, springs);
+    }
+
+    // The verlet prediction is the inertial target and initial guess
+    particles.Integrate(settings.damping, settings.timestepSquared);
+    m_inertia = particles.GetPositions();
+
+    const float inertiaWeight = 1.0f / settings.timestepSquared;
+    for(int j = 0; j < settings.iterations; ++j)
+    {
+        for(int i = 0; i < springs.GetParticleBatches(); ++i)
+        {
+            const int begin = springs.GetParticleBatchBegin(i);
+            threads.ParallelFor(springs.GetParticleBatchEnd(i) - begin, [&](int start, int end)
+            {
+                SolveBatch(particles, springs, begin + start, begin + end, inertiaWeight);
+            });
+        }
+    }
+}
+
+void VbdSolver::SolveBatch(ParticleStore& particles,
+                           const SpringStore& springs,
+                           int begin, int end,
+                           float inertiaWeight) const
+{
+    const std::vector<std::uint32_t>& order = springs.GetParticleOrder();
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+
+    for(int i = begin; i < end; ++i)
+    {
+        const std::uint32_t index = order[i];
+        if(flags[index] & (ParticleStore::PINNED|ParticleStore::SLEEPING))
+        {
+            continue;
+        }
+
+        // Gradient and symmetric hessian of the energy around the particle
+        const D3DXVECTOR3& position = positions[index];
+        D3DXVECTOR3 force((m_inertia[index] - position) * inertiaWeight);
+        float xx = inertiaWeight, xy = 0.0f, xz = 0.0f;
+        float yy = inertiaWeight, yz = 0.0f, zz = inertiaWeight;
+
+        for(int j = m_edgeOffsets[i]; j < m_edgeOffsets[i + 1]; ++j)
+        {
+            const D3DXVECTOR3 difference(position - positions[m_edges[j]]);
+            const float length = D3DXVec3Length(&difference);
+            if(length == 0.0f)
+            {
+                continue;
+            }
+
+            const float stiffness = m_stiffness[m_edgeType[j]];
+            const D3DXVECTOR3 direction(difference / length);
+            force -= direction * (stiffness * (length - m_edgeLength[j]));
+
+            // Compressed springs drop the transverse term to keep the hessian positive definite
+            const float transverse = stiffness * max(1.0f - (m_edgeLength[j] / length), 0.0f);
+            const float axial = stiffness - transverse;
+            xx += transverse + (axial * direction.x * direction.x);
+            yy += transverse + (axial * direction.y * direction.y);
+            zz += transverse + (axial * direction.z * direction.z);
+            xy += axial * direction.x * direction.y;
+            xz += axial * direction.x * direction.z;
+            yz += axial * direction.y * direction.z;
+        }
+
+        // Solve the 3x3 system with the adjugate of the hessian
+        const float cofactorXX = (yy * zz) - (yz * yz);
+        const float cofactorXY = (xz * yz) - (xy * zz);
+        const float cofactorXZ = (xy * yz) - (xz * yy);
+        const float determinant = (xx * cofactorXX) + (xy * cofactorXY) + (xz * cofactorXZ);
+        if(fabs(determinant) < MINIMUM_DETERMINANT)
+        {
+            continue;
+        }
+
+        const float cofactorYY = (xx * zz) - (xz * xz);
+        const float cofactorYZ = (xy * xz) - (xx * yz);
+        const float cofactorZZ = (xx * yy) - (xy * xy);
+
+        const D3DXVECTOR3 step(
+            (cofactorXX * force.x) + (cofactorXY * force.y) + (cofactorXZ * force.z),
+            (cofactorXY * force.x) + (cofactorYY * force.y) + (cofactorYZ * force.z),
+            (cofactorXZ * force.x) + (cofactorYZ * force.y) + (cofactorZZ * force.z));
+
+        positions[index] += step / determinant;
+    }
+}
+
+void VbdSolver::SetStiffness(SpringStore::Type type, float stiffness)
+{
+    m_stiffness[type] = max(stiffness, 0.0f);
+}
+
+float VbdSolver::GetStiffness(SpringStore::Type type) const
+{
+    return m_stiffness[type];
+}
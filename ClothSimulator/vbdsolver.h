@@ -0,0 +1,86 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - vbdsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springstore.h"
+#include "directx.h"
+
+#include <vector>
+
+/**
+* Vertex block descent solver
+* Each particle is moved by a single newton step that minimises the inertia
+* and spring energy around it while its neighbours are held fixed. Particles
+* of the same color share no springs and are solved in parallel, giving
+* fewer and larger parallel batches than solving the springs themselves.
+*/
+class VbdSolver : public ISolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    VbdSolver();
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "VBD"; }
+
+    /**
+    * Sets the stiffness for a type of spring
+    * @param type The type of spring to set
+    * @param stiffness The spring constant for the type
+    */
+    void SetStiffness(SpringStore::Type type, float stiffness);
+
+    /**
+    * @param type The type of spring to query
+    * @return the spring constant for the type of spring
+    */
+    float GetStiffness(SpringStore::Type type) const;
+
+private:
+
+    /**
+    * Solves a range of particles in a single batch
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param begin/end The range of the particle order in the batch
+    * @param inertiaWeight The particle mass divided by the timestep squared
+    */
+    void SolveBatch(ParticleStore& particles,
+                    const SpringStore& springs,
+                    int begin, int end,
+                    float inertiaWeight) const;
+
+    float m_stiffness[SpringStore::MAX_TYPES];  ///< Spring constant for each type of spring
+    std::vector<int> m_edgeOffsets;             ///< Offsets of the neighbours of each particle in batch order
+    std::vector<std::uint32_t> m_edges;         ///< Neighbouring particles connected by a spring
+    std::vector<float> m_edgeLength;            ///< Rest length of the spring to each neighbour
+    std::vector<unsigned char> m_edgeType;      ///< Type of the spring to each neighbour
+    std::vector<D3DXVECTOR3> m_inertia;         ///< Predicted positions from the particle velocities
+};
@@ -0,0 +1,143 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - xpbdsolver.cpp
+////////////////////////////////////////////////////////////////////////////////////////
+
+#include "xpbdsolver.h"
+#include "particlestore.h"
+#include "threadpool.h"
+#include "utils.h"
+
+#include <algorithm>
+
+namespace
+{
+    const int SUBSTEPS = 4;                   ///< Initial substeps for each tick
+    const float STRETCH_COMPLIANCE = 0.0f;    ///< Initial compliance for stretch springs
+    const float SHEAR_COMPLIANCE = 0.0001f;   ///< Initial compliance for shear springs
+    const float BEND_COMPLIANCE = 0.01f;      ///< Initial compliance for bending springs
+    const float HEAVY_WEIGHT = 1.0f / 9.0f;   ///< Inverse mass scale of the particle with the most interacting velocity
+}
+
+XpbdSolver::XpbdSolver()
+    : m_substeps(SUBSTEPS)
+{
+    m_compliance[SpringStore::STRETCH] = STRETCH_COMPLIANCE;
+    m_compliance[SpringStore::SHEAR] = SHEAR_COMPLIANCE;
+    m_compliance[SpringStore::BEND] = BEND_COMPLIANCE;
+}
+
+void XpbdSolver::Initialise(const ParticleStore& particles, const SpringStore& springs)
+{
+    m_lambda.resize(springs.Size());
+}
+
+void XpbdSolver::Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings)
+{
+    const float timestep = settings.timestep / m_substeps;
+    const float timestepSqr = timestep * timestep;
+    const float damping = pow(settings.damping, 1.0f / m_substeps);
+
+    float compliance[SpringStore::MAX_TYPES];
+    for(int i = 0; i < SpringStore::MAX_TYPES; ++i)
+    {
+        compliance[i] = m_compliance[i] / timestepSqr;
+    }
+
+    m_lambda.resize(springs.Size());
+    for(int step = 0; step < m_substeps; ++step)
+    {
+        // Predict the positions from the forces held for the whole tick
+        particles.Integrate(damping, timestepSqr);
+        std::fill(m_lambda.begin(), m_lambda.end(), 0.0f);
+
+        for(int j = 0; j < settings.iterations; ++j)
+        {
+            for(int i = 0; i < SpringStore::MAX_BATCHES; ++i)
+            {
+                const int begin = springs.GetBatchBegin(i);
+                threads.ParallelFor(springs.GetBatchEnd(i) - begin, [&](int start, int end)
+                {
+                    SolveBatch(particles, springs, begin + start, begin + end, compliance);
+                });
+            }
+        }
+    }
+}
+
+void XpbdSolver::SolveBatch(ParticleStore& particles,
+                            const SpringStore& springs,
+                            int begin, int end,
+                            const float* compliance)
+{
+    const std::vector<D3DXVECTOR3>& velocities = particles.GetInteractingVelocities();
+    const std::vector<unsigned char>& flags = particles.GetFlags();
+    const std::vector<std::uint32_t>& indices = springs.GetIndices();
+    const std::vector<float>& restLength = springs.GetRestLengths();
+    const std::vector<unsigned char>& types = springs.GetTypes();
+    std::vector<D3DXVECTOR3>& positions = particles.GetPositions();
+
+    for(int i = begin; i < end; ++i)
+    {
+        const std::uint32_t p1 = indices[i*2];
+        const std::uint32_t p2 = indices[i*2+1];
+        const D3DXVECTOR3& v1 = velocities[p1];
+        const D3DXVECTOR3& v2 = velocities[p2];
+
+        const unsigned char immovable = ParticleStore::PINNED|ParticleStore::SLEEPING;
+        float w1 = (flags[p1] & immovable) ? 0.0f : 1.0f;
+        float w2 = (flags[p2] & immovable) ? 0.0f : 1.0f;
+
+        if(v1 != v2 && (!IsZeroVector(v1) || !IsZeroVector(v2)))
+        {
+            // Move the particle with the smallest amount of interacting
+            // velocity towards the particle with the most amount
+            if(D3DXVec3LengthSq(&v1) > D3DXVec3LengthSq(&v2))
+            {
+                w1 *= HEAVY_WEIGHT;
+            }
+            else
+            {
+                w2 *= HEAVY_WEIGHT;
+            }
+        }
+
+        D3DXVECTOR3 difference(positions[p2] - positions[p1]);
+        const float distance = D3DXVec3Length(&difference);
+        if(distance == 0.0f || (w1 + w2) == 0.0f)
+        {
+            continue;
+        }
+
+        const float alpha = compliance[types[i]];
+        const float error = distance - restLength[i];
+        const float deltaLambda = (-error - (alpha * m_lambda[i])) / (w1 + w2 + alpha);
+        m_lambda[i] += deltaLambda;
+
+        const D3DXVECTOR3 correction((difference / distance) * deltaLambda);
+        positions[p1] -= correction * w1;
+        positions[p2] += correction * w2;
+    }
+}
+
+void XpbdSolver::SetCompliance(SpringStore::Type type, float compliance)
+{
+    m_compliance[type] = max(compliance, 0.0f);
+}
+
+float XpbdSolver::GetCompliance(SpringStore::Type type) const
+{
+    return m_compliance[type];
+}
+
+void XpbdSolver::SetSubsteps(int substeps)
+{
+    m_substeps = max(substeps, 1);
+}
+
+int XpbdSolver::GetSubsteps() const
+{
+    return m_substeps;
+}
@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////////////
+// Kara Jensen - mail@karajensen.com - xpbdsolver.h
+////////////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "solver_interface.h"
+#include "springstore.h"
+
+#include <vector>
+
+/**
+* Extended position based dynamics solver
+* Each spring holds a lagrange multiplier and a compliance for its type,
+* making the stiffness independent of the iterations and timestep
+*/
+class XpbdSolver : public ISolver
+{
+public:
+
+    /**
+    * Constructor
+    */
+    XpbdSolver();
+
+    /**
+    * Prepares any solver data when the cloth is recreated
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    */
+    virtual void Initialise(const ParticleStore& particles, const SpringStore& springs) override;
+
+    /**
+    * Moves the particles forward a single tick
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param threads The threads to split independent work across
+    * @param settings The cloth values for this tick
+    */
+    virtual void Solve(ParticleStore& particles,
+                       const SpringStore& springs,
+                       ThreadPool& threads,
+                       const SolverSettings& settings) override;
+
+    /**
+    * @return the name of the solver for diagnostics
+    */
+    virtual std::string GetName() const override { return "XPBD"; }
+
+    /**
+    * Sets the compliance for a type of spring
+    * @param type The type of spring to set
+    * @param compliance The inverse stiffness, where zero is rigid
+    */
+    void SetCompliance(SpringStore::Type type, float compliance);
+
+    /**
+    * @param type The type of spring to query
+    * @return the compliance for the type of spring
+    */
+    float GetCompliance(SpringStore::Type type) const;
+
+    /**
+    * @param substeps The number of substeps to split each tick into
+    */
+    void SetSubsteps(int substeps);
+
+    /**
+    * @return the number of substeps each tick is split into
+    */
+    int GetSubsteps() const;
+
+private:
+
+    /**
+    * Solves a single batch of springs
+    * @param particles The store holding the particle data
+    * @param springs The springs connecting the particles
+    * @param begin/end The range of springs in the batch
+    * @param compliance The compliance of each type scaled by the substep
+    */
+    void SolveBatch(ParticleStore& particles,
+                    const SpringStore& springs,
+                    int begin, int end,
+                    const float* compliance);
+
+    std::vector<float> m_lambda;                   ///< Lagrange multiplier for each spring
+    float m_compliance[SpringStore::MAX_TYPES];    ///< Inverse stiffness for each type of spring
+    int m_substeps;                                ///< Number of substeps for each tick
+};